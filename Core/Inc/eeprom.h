@@ -0,0 +1,62 @@
+/**
+ * @file        eeprom.h
+ * @brief       Data EEPROM driver
+ * @author      Esteban CADIC
+ * @version     1.0
+ * @date        2025
+ * @copyright   MIT License
+ *
+ */
+
+#ifndef INC_EEPROM_H_
+#define INC_EEPROM_H_
+
+#include "main.h"
+
+
+/*------------------------------------------------------------------------------
+	CONSTANTS
+------------------------------------------------------------------------------*/
+
+/** Data EEPROM size in bytes */
+#define EEPROM_SIZE				(DATA_EEPROM_END - DATA_EEPROM_BASE + 1)
+
+/*
+ * Data EEPROM layout (offsets from DATA_EEPROM_BASE)
+ */
+/** RFM69 AES-128 key, written at provisioning (erased value 0x00 means no key) */
+#define EEPROM_AES_KEY_ADDR		0x000
+#define EEPROM_AES_KEY_SIZE		16
+/** Sequence number of the last doorbell frame sent (kept across resets for the receiver duplicate suppression) */
+#define EEPROM_TX_SEQ_ADDR		0x010
+/** RFM69 output power learned by the adaptive power control (dBm, followed by its complement) */
+#define EEPROM_TX_POWER_ADDR	0x011
+#define EEPROM_TX_POWER_SIZE	2
+
+
+/*------------------------------------------------------------------------------
+	DECLARATIONS
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief Read bytes from the data EEPROM.
+ * 
+ * @param offset Offset from the beginning of the data EEPROM.
+ * @param data Pointer to the buffer to store the read bytes.
+ * @param size Number of bytes to read.
+ * @return 0 on success, -1 if the range is outside of the data EEPROM.
+ */
+extern int EEPROM_Read(uint32_t offset, uint8_t *data, size_t size);
+
+/**
+ * @brief Write bytes to the data EEPROM.
+ * Only the bytes that differ from the EEPROM content are programmed, to limit wear.
+ * 
+ * @param offset Offset from the beginning of the data EEPROM.
+ * @param data Pointer to the bytes to write.
+ * @param size Number of bytes to write.
+ * @return 0 on success, -1 if the range is outside of the data EEPROM, -2 on programming error.
+ */
+extern int EEPROM_Write(uint32_t offset, const uint8_t *data, size_t size);
+
+#endif /* INC_EEPROM_H_ */
@@ -0,0 +1,125 @@
+/**
+ * @file        frame.h
+ * @brief       Doorbell radio frame format
+ * @author      Esteban CADIC
+ * @version     1.0
+ * @date        2025
+ * @copyright   MIT License
+ *
+ * Frames are sent in RFM69 variable length packets:
+ * | Length (added by the driver) | Destination | Source | Sequence | Type | Payload (optional) |
+ * The destination is the first byte so the RFM69 hardware address filtering can be used.
+ * The helpers work in place in the radio buffers, nothing is copied.
+ *
+ */
+
+#ifndef INC_FRAME_H_
+#define INC_FRAME_H_
+
+#include "main.h"
+
+
+/*------------------------------------------------------------------------------
+	CONSTANTS
+------------------------------------------------------------------------------*/
+
+#define FRAME_TYPE_DOORBELL		0x01 /**< Doorbell press, payload: doorbell code */
+#define FRAME_TYPE_ACK			0x02 /**< Acknowledgment, same sequence number as the frame acknowledged, payload: RSSI (dBm) */
+
+/** Number of peers remembered for the duplicate suppression */
+#define FRAME_PEERS_SIZE		4
+
+/** Largest frame (RFM69 FIFO payload limit with AES) */
+#define FRAME_MAX_SIZE			64
+
+
+/*------------------------------------------------------------------------------
+	TYPE DEFINITIONS
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief Frame header.
+ */
+typedef struct FRAME_Header
+{
+	uint8_t dst; /**< Destination address */
+	uint8_t src; /**< Source ID */
+	uint8_t seq; /**< Sequence number */
+	uint8_t type; /**< Message type */
+} FRAME_Header_t;
+
+#define FRAME_HEADER_SIZE		sizeof(FRAME_Header_t)
+#define FRAME_MAX_PAYLOAD_SIZE	(FRAME_MAX_SIZE - FRAME_HEADER_SIZE)
+
+/**
+ * @brief Last frame received from a peer.
+ */
+typedef struct FRAME_Peer
+{
+	uint8_t src; /**< Source ID */
+	uint8_t last_seq; /**< Sequence number of the last frame accepted */
+	uint8_t valid; /**< Entry in use */
+	int32_t freq_offset_hz; /**< Carrier offset of the peer measured by the AFC (0 if unknown) */
+} FRAME_Peer_t;
+
+/**
+ * @brief Peer table used to drop the repeats of a frame (same source and sequence number).
+ */
+typedef struct FRAME_PeerTable
+{
+	FRAME_Peer_t peers[FRAME_PEERS_SIZE]; /**< Known peers */
+	uint8_t next; /**< Next entry replaced when a new peer is seen (round robin) */
+
+	uint32_t accepted; /**< Frames accepted */
+	uint32_t duplicates; /**< Repeats dropped (MCU wake-ups saved) */
+} FRAME_PeerTable_t;
+
+
+/*------------------------------------------------------------------------------
+	DECLARATIONS
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief Write a frame header at the beginning of a buffer.
+ * The payload is then written directly at the returned pointer.
+ * 
+ * @param buffer Pointer to the frame buffer (at least FRAME_HEADER_SIZE bytes).
+ * @param dst Destination address.
+ * @param src Source ID.
+ * @param seq Sequence number.
+ * @param type Message type.
+ * @return Pointer to the payload in the buffer.
+ */
+extern uint8_t *FRAME_Pack(uint8_t *buffer, uint8_t dst, uint8_t src, uint8_t seq, uint8_t type);
+
+/**
+ * @brief Get the header and the payload of a received frame, in place.
+ * 
+ * @param buffer Pointer to the received bytes.
+ * @param length Number of received bytes.
+ * @param payload Pointer to store the payload pointer (can be NULL).
+ * @param payload_size Pointer to store the payload size (can be NULL).
+ * @return Pointer to the header in the buffer, NULL if the frame is too short.
+ */
+extern const FRAME_Header_t *FRAME_Unpack(const uint8_t *buffer, size_t length, const uint8_t **payload, size_t *payload_size);
+
+/**
+ * @brief Find a peer in the peer table.
+ * 
+ * @param table Pointer to the peer table.
+ * @param src Source ID of the peer.
+ * @return Pointer to the peer entry, NULL if the peer is unknown.
+ */
+extern FRAME_Peer_t *FRAME_GetPeer(FRAME_PeerTable_t *table, uint8_t src);
+
+/**
+ * @brief Check if a received frame is a repeat of the last frame accepted from its source.
+ * New frames are recorded in the peer table, repeats are counted.
+ * 
+ * @param table Pointer to the peer table.
+ * @param header Pointer to the frame header.
+ * @return 1 if the frame is a duplicate, 0 if it is new.
+ */
+extern uint8_t FRAME_IsDuplicate(FRAME_PeerTable_t *table, const FRAME_Header_t *header);
+
+#endif /* INC_FRAME_H_ */
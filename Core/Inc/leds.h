@@ -37,4 +37,11 @@ extern void LEDs_Reset(void);
  */
 extern void LEDs_RXMessage(void);
 
+/**
+ * @brief Blink the LEDs twice quickly to indicate that the doorbell was acknowledged by the receiver.
+ * Depending on the battery voltage, the green or red LED will blink.
+ * 
+ */
+extern void LEDs_Acknowledged(void);
+
 #endif /* INC_LEDS_H_ */
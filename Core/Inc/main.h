@@ -38,6 +38,7 @@ extern "C" {
 /* USER CODE BEGIN ET */
 extern uint8_t g_flag_switch;
 extern uint8_t g_flag_message;
+extern uint8_t g_flag_wakeup;
 /* USER CODE END ET */
 
 /* Exported constants --------------------------------------------------------*/
@@ -13,6 +13,7 @@
 #define INC_RFM69_H_
 
 #include "main.h"
+#include "rfm69_phy.h"
 
 
 /*------------------------------------------------------------------------------
@@ -25,11 +26,75 @@
 #define RFM69_MODE_TX		3
 #define RFM69_MODE_RX		4
 
+#define RFM69_DI0_TX_PACKET_SENT	0
 #define RFM69_DI0_RX_PAYLOAD_READY 	1
 #define RFM69_DI0_TX_NONE			2
 
+#define RFM69_PHY_DEFAULT		0 /**< 10 kbps, 20 kHz deviation, 25 kHz channel filter */
+#define RFM69_PHY_LONG_RANGE	1 /**< 1.2 kbps, 5 kHz deviation, 12.5 kHz channel filter */
+#define RFM69_PHY_FAST			2 /**< 50 kbps, 50 kHz deviation, 100 kHz channel filter */
+#define RFM69_PHY_FASTEST		3 /**< 100 kbps, 100 kHz deviation, 200 kHz channel filter */
+#define RFM69_PHY_COUNT			4
+
 #define RFM69_TIMEOUT_MS	4000
 
+#define RFM69_OK		0 /**< Operation complete */
+#define RFM69_BUSY		1 /**< Operation in progress (RFM69_Poll()), or another operation already in progress (RFM69_Start...()) */
+#define RFM69_ERROR		(-1) /**< Invalid parameter or module not responding */
+#define RFM69_TIMEOUT	(-10) /**< The module didn't complete the operation in time */
+#define RFM69_NO_PACKET	(-11) /**< No valid packet received before the reception timeout */
+
+#define RFM69_OP_NONE		0
+#define RFM69_OP_MODE		1 /**< RFM69_StartSetMode() */
+#define RFM69_OP_SEND		2 /**< RFM69_StartSend() */
+#define RFM69_OP_RECEIVE	3 /**< RFM69_StartReceive() */
+
+/** Operation timing counters (RFM69_t.counters) */
+#define RFM69_COUNTER_MODE		0 /**< Mode changes (ModeReady waits, RFM69_StartSetMode()) */
+#define RFM69_COUNTER_SEND		1 /**< RFM69_SendMessage(), RFM69_StartSend() */
+#define RFM69_COUNTER_RECEIVE	2 /**< RFM69_ReceiveMessage(), RFM69_StartReceive() */
+#define RFM69_COUNTER_BURST		3 /**< RFM69_SendBurst() */
+#define RFM69_COUNTER_STREAM	4 /**< RFM69_ReceiveStream() */
+#define RFM69_COUNTER_NOISE		5 /**< RFM69_SampleNoise() */
+#define RFM69_COUNTER_COUNT		6
+
+#define RFM69_LISTEN_CRITERIA_RSSI	0 /**< Stay in RX when the RSSI is above the threshold */
+#define RFM69_LISTEN_CRITERIA_SYNC	1 /**< Stay in RX when the RSSI is above the threshold and the sync word is received */
+
+/** RSSI threshold set by RFM69_Init() */
+#define RFM69_RSSI_THRESH_DEFAULT_DBM	-90
+/** Smallest threshold change applied by RFM69_AdaptRssiThreshold() */
+#define RFM69_RSSI_THRESH_HYSTERESIS_DB	3
+
+#define RFM69_AES_KEY_SIZE	16
+
+/** FIFO size, longer packets are streamed through the FIFO while on air */
+#define RFM69_FIFO_SIZE			66
+/** FifoThreshold: FifoLevel is raised above this number of bytes (FIFO streaming chunk size) */
+#define RFM69_FIFO_THRESHOLD	32
+/** Largest payload (variable length packet format) */
+#define RFM69_MAX_PAYLOAD_SIZE	255
+/** Largest payload with AES encryption (no FIFO streaming) */
+#define RFM69_AES_MAX_PAYLOAD_SIZE	64
+
+#define RFM69_ADDRESS_FILTERING_NONE		0
+#define RFM69_ADDRESS_FILTERING_NODE		1 /**< Address must match the node address */
+#define RFM69_ADDRESS_FILTERING_BROADCAST	2 /**< Address must match the node or the broadcast address */
+
+#define RFM69_SPI_BLOCKING	0
+#define RFM69_SPI_DMA		1
+
+/** Shadowed register range (RegOpMode to RegPacketConfig2), write-only AES keys are not shadowed */
+#define RFM69_SHADOW_FIRST	0x01
+#define RFM69_SHADOW_LAST	0x3D
+#define RFM69_SHADOW_SIZE	(RFM69_SHADOW_LAST - RFM69_SHADOW_FIRST + 1)
+
+/** Largest carrier frequency correction (RFM69_SetFrequencyCorrection()) */
+#define RFM69_FREQ_CORRECTION_MAX_HZ	50000
+
+/** Smallest transfer sent through DMA, shorter transfers are faster in blocking mode */
+#define RFM69_DMA_MIN_SIZE	4
+
 
 /*------------------------------------------------------------------------------
 	TYPE DEFINITIONS
@@ -44,6 +109,64 @@ struct pin_state
 	uint16_t pin;
 };
 
+/**
+ * @brief Link quality statistics, updated by RFM69_ReceiveMessage().
+ */
+typedef struct RFM69_Stats
+{
+	uint32_t packets; /**< Packets received */
+	uint32_t crc_failures; /**< Packets dropped on CRC error (counted when enabled with RFM69_SetCrcFailureCount()) */
+	uint32_t false_wakes; /**< Receptions in listen mode without any payload (noise, filtered address) */
+
+	uint32_t noise_samples; /**< Channel RSSI samples taken with RFM69_SampleNoise() */
+	uint32_t noise_above_thresh; /**< Samples above the listen mode RSSI threshold (would hold the radio in RX) */
+
+	int16_t rssi_min; /**< Weakest packet RSSI in dBm */
+	int16_t rssi_max; /**< Strongest packet RSSI in dBm */
+	int32_t rssi_sum; /**< Sum of the packet RSSI in dBm, for the mean */
+	uint32_t rssi_count; /**< Number of RSSI samples in rssi_sum */
+} RFM69_Stats_t;
+
+/**
+ * @brief Timing counters of an operation type, durations measured with the SysTick (microsecond resolution).
+ */
+typedef struct RFM69_Counter
+{
+	uint32_t calls; /**< Operations completed */
+	uint32_t timeouts; /**< Operations ended by RFM69_TIMEOUT (module not responding) */
+	uint32_t untimed; /**< Operations run without the HAL tick (STOP mode clock), left out of the durations */
+	uint32_t min_us; /**< Shortest operation */
+	uint32_t max_us; /**< Longest operation */
+	uint64_t total_us; /**< Time spent in the operation, for the mean */
+} RFM69_Counter_t;
+
+/**
+ * @brief Listen mode timing, see RFM69_ComputeListenConfig().
+ */
+typedef struct RFM69_Listen
+{
+	uint8_t resol_idle; /**< ListenResolIdle (1: 64 us, 2: 4.1 ms, 3: 262 ms) */
+	uint8_t coef_idle; /**< ListenCoefIdle */
+	uint8_t resol_rx; /**< ListenResolRx (1: 64 us, 2: 4.1 ms, 3: 262 ms) */
+	uint8_t coef_rx; /**< ListenCoefRx */
+
+	uint32_t idle_us; /**< Idle duration achieved */
+	uint32_t rx_us; /**< RX duration achieved */
+	uint32_t duty_cycle_ppm; /**< Share of the listen period spent in RX, in parts per million */
+	uint32_t avg_current_na; /**< Estimated average module current (no packet received), in nA */
+} RFM69_Listen_t;
+
+struct RFM69;
+
+/**
+ * @brief Asynchronous operation completion callback.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param operation Operation completed (see rfm69.h for available operations).
+ * @param status RFM69_OK, RFM69_TIMEOUT or RFM69_NO_PACKET.
+ */
+typedef void (*RFM69_Callback_t)(struct RFM69 *rfm69, uint8_t operation, int status);
+
 /**
  * @brief RFM69 structure.
  * This structure contains the configuration of the RFM69 module.
@@ -51,13 +174,47 @@ struct pin_state
 typedef struct RFM69
 {
 	SPI_HandleTypeDef *spi; /**< SPI peripheral */
+	uint8_t spi_transport; /**< SPI transport (RFM69_SPI_BLOCKING or RFM69_SPI_DMA) */
 
 	struct pin_state reset; /**< SPI Reset GPIO */
 	struct pin_state cs; /**< SPI CS GPIO */
+	struct pin_state dio0; /**< DIO0 IRQ GPIO */
 
 	uint8_t high_power_en; /**< High power mode module compatibility */
+	uint8_t phy_profile; /**< PHY profile applied by RFM69_Init() (see rfm69.h for available profiles) */
+	uint8_t tx_irq_en; /**< Sleep until PacketSent is signaled on DIO0 instead of polling the module (dio0 must be set) */
+	uint8_t listen_criteria; /**< Listen mode criteria applied by RFM69_ActiveListenMode() (see rfm69.h for available criteria) */
+	uint8_t listen_payload_size; /**< Largest payload expected in listen mode, sets the RX timeouts (0: RegPayloadLength) */
+	uint32_t rx_timeout_margin_us; /**< Margin added to the listen mode RX timeouts */
+	RFM69_Callback_t op_callback; /**< Called from RFM69_Poll() when an operation completes, blocking functions included (can be NULL) */
+
+	uint32_t spi_transactions; /**< Number of SPI transactions (chip select cycles) since startup */
+	uint32_t spi_time_us; /**< Time spent in SPI transactions since startup (MCU time of the register and FIFO accesses, HAL tick running) */
+	RFM69_Stats_t stats; /**< Link quality statistics since RFM69_Init() or RFM69_ResetStats() */
+	RFM69_Counter_t counters[RFM69_COUNTER_COUNT]; /**< Operation timing since RFM69_Init() or RFM69_ResetCounters() */
 
 	uint8_t _listen_mode_activated; /**< Listen mode activated internal flag */
+	int8_t _power_dbm; /**< Current output power */
+	uint8_t _afc_en; /**< AFC enabled internal flag */
+	int32_t _freq_correction_hz; /**< Carrier frequency correction currently applied */
+	int32_t _freq_offset_hz; /**< Carrier offset of the last packet received (AFC) */
+	int16_t _rssi_thresh_dbm; /**< RSSI threshold of the listen mode */
+	uint32_t _spi_start_us; /**< Start of the SPI transaction in progress */
+	int16_t _noise_floor_q4; /**< Noise floor estimate in 1/16 dBm (valid when stats.noise_samples > 0) */
+
+	uint8_t _op; /**< Asynchronous operation in progress */
+	uint8_t _op_state; /**< State of the operation in progress */
+	int _op_status; /**< Result of the last operation */
+	uint32_t _op_tick; /**< Tick of the last state change */
+	uint32_t _op_start_us; /**< Start of the operation in progress (timing counters) */
+	uint32_t _op_rx_timeout_ms; /**< Time to wait for a packet */
+	uint8_t *_op_data; /**< Message sent or reception buffer */
+	size_t _op_size; /**< Message size or reception buffer size */
+	size_t _op_bytes; /**< Bytes written to the FIFO or received */
+	int16_t _op_rssi; /**< RSSI of the packet received */
+
+	uint8_t _shadow[RFM69_SHADOW_SIZE]; /**< Last value written to (or read from) each shadowed register */
+	uint8_t _shadow_valid[(RFM69_SHADOW_SIZE + 7) / 8]; /**< Shadow validity bitmap */
 } RFM69_t;
 
 
@@ -66,66 +223,240 @@ typedef struct RFM69
 ------------------------------------------------------------------------------*/
 
 /**
- * @brief Initialize the RFM69 module. The base configuration is sent to the module.
+ * @brief Initialize the RFM69 module. The base configuration and the PHY profile selected
+ * in the RFM69 structure (phy_profile) are sent to the module.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return RFM69_OK, RFM69_ERROR if the module doesn't answer (RegVersion).
+ */
+extern int RFM69_Init(RFM69_t *rfm69);
+
+/**
+ * @brief Resynchronize the register shadow with the RFM69 module.
+ * All shadowed registers are read back in one burst transaction. Call it after a radio reset
+ * or if the module may have lost its configuration. Read-only bits (e.g. the RegLna gain set by the AGC) are ignored.
  * 
  * @param rfm69 Pointer to the RFM69 structure.
+ * @return Number of registers whose value differed from the shadow (0 if the shadow was in sync).
  */
-extern void RFM69_Init(RFM69_t *rfm69);
+extern size_t RFM69_ResyncShadow(RFM69_t *rfm69);
+
+/**
+ * @brief Check that the module still holds the configuration written by the driver, e.g. after a
+ * brownout during a high power burst. The shadowed registers are read back in one burst transaction
+ * and compared to the shadow through the writable bits mask, only the registers that differ are
+ * written again (consecutive ones in one burst). RegTestLna and the high power RegTestPa1/RegTestPa2
+ * are checked against the output power. RegOpMode is not restored (the mode is set by the caller),
+ * its shadow takes the value read back.
+ * A module reset clears the write-only AES key: if AesOn was lost it is not restored, encryption
+ * stays disabled until the key is loaded again with RFM69_SetAESKey() (see RFM69_AESIsEnabled()).
+ * The AesOn loss is counted in the registers restored.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return Number of registers restored (0 if the configuration was intact).
+ */
+extern size_t RFM69_VerifyConfig(RFM69_t *rfm69);
 
 /**
  * @brief Send a custom configuration to the RFM69 module.
+ * Consecutive register addresses in the table are merged into a single burst write,
+ * so keep the table sorted to reduce SPI transactions. The FIFO (0x00) must not be part of the table.
+ * Registers already holding the requested value (according to the shadow) are skipped.
  * 
  * @param rfm69 Pointer to the RFM69 structure.
  * @param config Pointer to the configuration array.
  * @param config_size Size of the configuration array.
+ * @return RFM69_OK, RFM69_ERROR if the table holds the FIFO or an address out of the register map (nothing written).
+ */
+extern int RFM69_SetCustomConfig(RFM69_t *rfm69, const uint8_t config[][2], size_t config_length);
+
+/**
+ * @brief Change the PHY profile (bitrate, frequency deviation and channel filter) of the RFM69 module.
+ * Both ends of the link must use the same profile.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param profile Profile to set (see rfm69.h for available profiles).
+ * @return 0 on success, -1 if the profile doesn't exist.
+ */
+extern int RFM69_SetPhyProfile(RFM69_t *rfm69, uint8_t profile);
+
+/**
+ * @brief Load an AES-128 key in the RFM69 module and enable the hardware packet encryption.
+ * Encryption and decryption are done by the module, with no MCU processing per packet.
+ * Both ends of the link must use the same key. With AES, payloads are limited to 64 bytes.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param key Pointer to the 16 bytes key, NULL to disable the encryption.
+ * @return RFM69_OK, RFM69_ERROR if the maximum payload size is above the AES limit (see RFM69_SetMaxPayloadSize()).
+ */
+extern int RFM69_SetAESKey(RFM69_t *rfm69, const uint8_t *key);
+
+/**
+ * @brief Check if the AES encryption is enabled (AesOn), e.g. after RFM69_VerifyConfig().
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return 1 if the packets are encrypted, 0 otherwise.
+ */
+extern uint8_t RFM69_AESIsEnabled(RFM69_t *rfm69);
+
+/**
+ * @brief Configure the hardware address filtering of the RFM69 module.
+ * The first payload byte is the destination address. Packets that don't match are dropped
+ * by the module, PayloadReady is not raised and the MCU is not woken up.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param filtering Filtering mode (see rfm69.h for available modes).
+ * @param node_address Address of this node.
+ * @param broadcast_address Broadcast address (used with RFM69_ADDRESS_FILTERING_BROADCAST).
+ * @return 0 on success, -1 if the filtering mode doesn't exist.
  */
-extern void RFM69_SetCustomConfig(RFM69_t *rfm69, const uint8_t config[][2], size_t config_length);
+extern int RFM69_SetAddressFiltering(RFM69_t *rfm69, uint8_t filtering, uint8_t node_address, uint8_t broadcast_address);
 
 /**
  * @brief Change the mode of the RFM69 module.
  * 
  * @param rfm69 Pointer to the RFM69 structure.
  * @param mode Mode to set (see rfm69.h for available modes).
+ * @return RFM69_OK, RFM69_ERROR if the mode doesn't exist, RFM69_BUSY if an asynchronous operation is in progress.
  */
-extern void RFM69_SetMode(RFM69_t *rfm69, uint8_t mode);
+extern int RFM69_SetMode(RFM69_t *rfm69, uint8_t mode);
 
 /**
  * @brief Change the DI0 interrupt mapping of the RFM69 module.
  * 
  * @param rfm69 Pointer to the RFM69 structure.
  * @param mapping Mapping to set (see rfm69.h for available mappings).
+ * @return RFM69_OK, RFM69_ERROR if the mapping doesn't exist.
  */
-extern void RFM69_ChangeDI0Mapping(RFM69_t *rfm69, uint8_t mapping);
+extern int RFM69_ChangeDI0Mapping(RFM69_t *rfm69, uint8_t mapping);
 
 /**
  * @brief Activate the listen mode of the RFM69 module.
  * This mode allows the module to discontinuously listen for incoming packets.
- * See main.c or RFM69 datasheet for the configuration parameters.
+ * See RFM69_ComputeListenConfig() or RFM69 datasheet for the configuration parameters,
+ * RFM69_ActiveListenModeUs() takes durations instead.
+ * The RX timeouts are computed for the current bitrate: TimeoutRxStart covers the RX window,
+ * TimeoutRssiThresh two packets of listen_payload_size bytes (the one already on air when the RSSI
+ * threshold is crossed and the next one), both plus rx_timeout_margin_us. Noise above the RSSI
+ * threshold then holds the radio in RX for TimeoutRssiThresh only.
  * 
  * @param rfm69 Pointer to the RFM69 structure.
  * @param resol_idle Resolution for the listen idle mode
  * @param coef_idle Coefficient for the listen idle mode
  * @param resol_rx Resolution for the listen RX mode
  * @param coef_rx Coefficient for the listen RX mode
+ * @return RFM69_OK, RFM69_ERROR if a resolution is not 1 to 3 or a coefficient is 0.
+ */
+extern int RFM69_ActiveListenMode(RFM69_t *rfm69, uint8_t resol_idle, uint8_t coef_idle, uint8_t resol_rx, uint8_t coef_rx);
+
+/**
+ * @brief Compute the listen mode register encoding for idle and RX durations.
+ * Each duration is coded as a resolution times a coefficient (1 to 255):
+ * | ListenResolX | Min duration (ListenCoef = 1) | Max duration (ListenCoef = 255) |
+ * |--------------|-------------------------------|---------------------------------|
+ * | 01           | 64 us                         | 16 ms                           |
+ * | 10           | 4.1 ms                        | 1.04 s                          |
+ * | 11           | 0.26 s                        | 67 s                            |
+ * The idle duration is rounded to the closest value, the RX duration is rounded up so the RX window
+ * is never shorter than requested. The finest resolution wins on equal error.
+ * 
+ * @param idle_us Idle duration wanted in microseconds.
+ * @param rx_us RX duration wanted in microseconds.
+ * @param listen Pointer to store the encoding, the achieved durations and the power estimation.
+ * @return 0 on success, -1 if a duration is outside of the listen mode range.
+ */
+extern int RFM69_ComputeListenConfig(uint32_t idle_us, uint32_t rx_us, RFM69_Listen_t *listen);
+
+/**
+ * @brief Activate the listen mode of the RFM69 module with idle and RX durations in microseconds.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param idle_us Idle duration wanted in microseconds.
+ * @param rx_us RX duration wanted in microseconds.
+ * @param listen Pointer to store the configuration applied (can be NULL).
+ * @return 0 on success, -1 if a duration is outside of the listen mode range (listen mode is not changed).
+ */
+extern int RFM69_ActiveListenModeUs(RFM69_t *rfm69, uint32_t idle_us, uint32_t rx_us, RFM69_Listen_t *listen);
+
+/**
+ * @brief Get the period of the listen mode cycle (idle + RX) currently configured in the RFM69 module.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return Listen mode period in microseconds.
+ */
+extern uint32_t RFM69_GetListenPeriodUs(RFM69_t *rfm69);
+
+/**
+ * @brief Get the shortest TX burst duration that guarantees that a listening receiver (using the same
+ * listen mode and PHY configuration) opens at least rx_windows RX windows while the burst is on air.
+ * The last window must be able to receive a full packet: the burst is N listen periods plus two packets
+ * (the one detected by RSSI when the window opens and the next complete one).
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param rx_windows Number of receiver listen windows to cover.
+ * @param payload_size Size of the payload sent during the burst.
+ * @return Burst duration in milliseconds.
  */
-extern void RFM69_ActiveListenMode(RFM69_t *rfm69, uint8_t resol_idle, uint8_t coef_idle, uint8_t resol_rx, uint8_t coef_rx);
+extern uint32_t RFM69_GetListenBurstMs(RFM69_t *rfm69, uint8_t rx_windows, size_t payload_size);
 
 /**
  * @brief Disable the listen mode of the RFM69 module.
  * 
  * @param rfm69 Pointer to the RFM69 structure.
  * @param mode Mode to set after disabling listen mode (see rfm69.h for available modes).
+ * @return RFM69_OK once the mode is ready, RFM69_ERROR if the mode doesn't exist, RFM69_TIMEOUT.
+ */
+extern int RFM69_DisableListenMode(RFM69_t *rfm69, uint8_t mode);
+
+/**
+ * @brief Send a message over the air using the RFM69 module (blocking RFM69_StartSend()).
+ * If tx_irq_en is set, DIO0 is mapped to PacketSent and the MCU sleeps until the DIO0 interrupt.
+ * The DI0 mapping must then be restored (e.g. RFM69_DI0_RX_PAYLOAD_READY) before receiving.
+ * In variable length packet format, the length byte is added by the driver.
+ * Messages longer than the FIFO (up to RFM69_MAX_PAYLOAD_SIZE, RFM69_AES_MAX_PAYLOAD_SIZE with AES)
+ * are streamed: the FIFO is refilled while the packet is on air. Longer messages are not sent.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param message Pointer to the message to send.
+ * @param message_size Size of the message to send.
+ * @return RFM69_OK, RFM69_ERROR if the size is not valid, RFM69_TIMEOUT if the module didn't send the packet.
  */
-extern void RFM69_DisableListenMode(RFM69_t *rfm69, uint8_t mode);
+extern int RFM69_SendMessage(RFM69_t *rfm69, uint8_t *message, size_t message_lenght);
 
 /**
- * @brief Send a message over the air using the RFM69 module.
+ * @brief Send the same message repeatedly during a time window.
+ * The module stays in FS mode between packets (synthesizer locked), only the PA is ramped for each packet.
+ * The module is put in sleep mode at the end of the burst.
  * 
  * @param rfm69 Pointer to the RFM69 structure.
  * @param message Pointer to the message to send.
  * @param message_size Size of the message to send.
+ * @param duration_ms Duration of the burst in milliseconds.
+ * @return Number of packets sent during the burst, RFM69_GetStatus() tells if the burst was cut by a timeout
+ * (or RFM69_BUSY if an asynchronous operation is in progress).
+ */
+extern size_t RFM69_SendBurst(RFM69_t *rfm69, uint8_t *message, size_t message_size, uint32_t duration_ms);
+
+/**
+ * @brief Get the on-air time of a packet with the current configuration (preamble, sync word,
+ * length byte, payload padded to the AES block size when encryption is on, and CRC at the configured bitrate).
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param payload_size Size of the payload.
+ * @return Time on air in microseconds.
  */
-extern void RFM69_SendMessage(RFM69_t *rfm69, uint8_t *message, size_t message_lenght);
+extern uint32_t RFM69_GetPacketAirtimeUs(RFM69_t *rfm69, size_t payload_size);
+
+/**
+ * @brief Estimate the energy drawn by the module to transmit a packet with the current PHY profile
+ * and output power (typical TX currents from the RFM69HCW datasheet).
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param payload_size Size of the payload.
+ * @param supply_mv Supply voltage in millivolts.
+ * @return Energy per packet in microjoules.
+ */
+extern uint32_t RFM69_GetPacketEnergyUJ(RFM69_t *rfm69, size_t payload_size, uint16_t supply_mv);
 
 /**
  * @brief Set the output power of the RFM69 module.
@@ -138,14 +469,249 @@ extern void RFM69_SendMessage(RFM69_t *rfm69, uint8_t *message, size_t message_l
 extern int RFM69_SetPowerDBm(RFM69_t *rfm69, int8_t dBm);
 
 /**
- * @brief Active receive mode and try to read a message from the RFM69 FIFO.
+ * @brief Active receive mode and try to read a message from the RFM69 FIFO (blocking RFM69_StartReceive()
+ * with no wait for a packet).
  * The module stay in RX mode after the function call if listen mode is not activated.
+ * The payload is read in a single burst transaction. In variable length packet format,
+ * the length byte is not copied to the buffer.
+ * The RSSI and the IRQ flags are read in the same transaction, before leaving RX.
  * 
  * @param rfm69 Pointer to the RFM69 structure.
  * @param buffer Pointer to the buffer to store the received message.
  * @param buffer_size Size of the buffer.
- * @return Number of bytes read from the RFM69 FIFO.
+ * @param rssi Pointer to store the RSSI of the packet in dBm (can be NULL), only written if a message is read.
+ * @return Number of bytes read from the RFM69 FIFO, see RFM69_GetStatus() when 0.
+ */
+extern size_t RFM69_ReceiveMessage(RFM69_t *rfm69, uint8_t *buffer, size_t buffer_size, int16_t *rssi);
+
+/**
+ * @brief Enable the automatic frequency correction (AFC) of the RFM69 module.
+ * The AFC runs at the start of each reception, within the AFC bandwidth of the PHY profile,
+ * and centers the channel filter on the received signal. The carrier offset of each packet is then
+ * available with RFM69_GetFrequencyOffsetHz().
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param enable 1 to enable the AFC, 0 to disable it.
+ * @return RFM69_OK, RFM69_ERROR if enable is not 0 or 1.
+ */
+extern int RFM69_SetAFC(RFM69_t *rfm69, uint8_t enable);
+
+/**
+ * @brief Get the carrier offset of the last packet received, measured by the AFC (AFC must be enabled).
+ * The offset is relative to the nominal carrier frequency, the frequency correction is taken into account.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return Carrier frequency of the sender minus the nominal carrier frequency, in Hz.
+ */
+extern int32_t RFM69_GetFrequencyOffsetHz(RFM69_t *rfm69);
+
+/**
+ * @brief Shift the carrier frequency of the module (TX and RX) from the nominal frequency.
+ * Centering the receiver on a known sender offset allows a narrower channel filter (RFM69_SetRxBandwidth()).
+ * The correction is reset by RFM69_SetPhyProfile().
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param offset_hz Frequency correction in Hz.
+ * @return 0 on success, -1 if the correction is larger than RFM69_FREQ_CORRECTION_MAX_HZ.
+ */
+extern int RFM69_SetFrequencyCorrection(RFM69_t *rfm69, int32_t offset_hz);
+
+/**
+ * @brief Change the channel filter bandwidth of the current PHY profile.
+ * A narrower filter lets less noise in and improves the sensitivity, but must still contain the signal
+ * (Fdev + BR/2) and the residual carrier offset. The setting is reset by RFM69_SetPhyProfile().
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param bandwidth_hz Smallest single side bandwidth wanted, in Hz.
+ * @return Bandwidth set in Hz, 0 if it would be narrower than the signal (nothing is changed).
+ */
+extern uint32_t RFM69_SetRxBandwidth(RFM69_t *rfm69, uint32_t bandwidth_hz);
+
+/**
+ * @brief Start a mode change without waiting for the module to be ready.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param mode Mode to set (see rfm69.h for available modes).
+ * @return RFM69_OK if started, RFM69_BUSY if another operation is in progress, -1 if the mode doesn't exist.
+ */
+extern int RFM69_StartSetMode(RFM69_t *rfm69, uint8_t mode);
+
+/**
+ * @brief Start sending a message. The steps of the transmission (standby, FIFO write and refill, TX,
+ * sleep) are run by RFM69_Poll(). The message must stay valid until the operation completes.
+ * The module is also put in sleep mode when the operation times out (PA off).
+ * With tx_irq_en, DIO0 is mapped to PacketSent (see RFM69_SendMessage()).
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param message Pointer to the message to send.
+ * @param message_size Size of the message.
+ * @return RFM69_OK if started, RFM69_BUSY if another operation is in progress, -1 if the size is not valid.
+ */
+extern int RFM69_StartSend(RFM69_t *rfm69, uint8_t *message, size_t message_size);
+
+/**
+ * @brief Start waiting for a message. RX mode is entered (unless listen mode is activated) and the payload
+ * is read by RFM69_Poll() as soon as it is received, see RFM69_ReceiveMessage().
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param buffer Pointer to the buffer to store the received message, must stay valid until the operation completes.
+ * @param buffer_size Size of the buffer.
+ * @param timeout_ms Time to wait for a packet (0: check once).
+ * @return RFM69_OK if started, RFM69_BUSY if another operation is in progress.
+ */
+extern int RFM69_StartReceive(RFM69_t *rfm69, uint8_t *buffer, size_t buffer_size, uint32_t timeout_ms);
+
+/**
+ * @brief Run the operation in progress. Call it until it returns something else than RFM69_BUSY,
+ * the MCU can sleep or do other work in between (e.g. until the DIO0 interrupt).
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return RFM69_BUSY while the operation is in progress, then its result (RFM69_OK, RFM69_TIMEOUT,
+ * or RFM69_NO_PACKET when no packet was received in time).
+ */
+extern int RFM69_Poll(RFM69_t *rfm69);
+
+/**
+ * @brief Get the result of the last operation, blocking functions included
+ * (e.g. RFM69_SendBurst() or RFM69_ReceiveStream() that return a size).
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return RFM69_OK, RFM69_ERROR, RFM69_TIMEOUT or RFM69_NO_PACKET.
+ */
+extern int RFM69_GetStatus(RFM69_t *rfm69);
+
+/**
+ * @brief Get the result of the last reception.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param rssi Pointer to store the RSSI of the packet in dBm (can be NULL), only written if a message was read.
+ * @return Number of bytes received.
+ */
+extern size_t RFM69_GetReceivedSize(RFM69_t *rfm69, int16_t *rssi);
+
+/**
+ * @brief Receive a packet longer than the FIFO (up to RFM69_MAX_PAYLOAD_SIZE), draining the FIFO while it is received.
+ * Listen mode must be disabled: the module is put in RX mode and the FIFO is polled until the whole
+ * packet is read. RFM69_SetMaxPayloadSize() must allow the packet length.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param buffer Pointer to the buffer to store the received message.
+ * @param buffer_size Size of the buffer.
+ * @param timeout_ms Time to wait for the beginning of a packet, and then for the rest of it.
+ * @return Number of bytes received, 0 on timeout, CRC error or packet larger than the buffer (dropped).
+ */
+extern size_t RFM69_ReceiveStream(RFM69_t *rfm69, uint8_t *buffer, size_t buffer_size, uint32_t timeout_ms);
+
+/**
+ * @brief Set the largest payload accepted in RX (RegPayloadLength), longer packets are dropped by the module.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param size Largest payload size (RFM69_AES_MAX_PAYLOAD_SIZE with AES).
+ * @return 0 on success, -1 if the size is not allowed with AES.
+ */
+extern int RFM69_SetMaxPayloadSize(RFM69_t *rfm69, uint8_t size);
+
+/**
+ * @brief Count the packets received with a CRC error in the statistics.
+ * The module then raises PayloadReady for corrupted packets too (CrcAutoClearOff), they are dropped
+ * by the driver but each one wakes up the MCU in listen mode. Keep it disabled outside link diagnostics.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param enable 1 to count the CRC failures, 0 to let the module drop them silently.
+ * @return RFM69_OK, RFM69_ERROR if enable is not 0 or 1.
+ */
+extern int RFM69_SetCrcFailureCount(RFM69_t *rfm69, uint8_t enable);
+
+/**
+ * @brief Measure the channel RSSI and count it in the noise statistics.
+ * Listen mode is interrupted for the measurement (about 1 ms in RX) and resumed.
+ * Call it when the channel is expected to be free, e.g. before putting the MCU back to sleep.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return Channel RSSI in dBm (RFM69_GetStatus() is RFM69_TIMEOUT if the measurement didn't complete),
+ * 0 and RFM69_GetStatus() RFM69_BUSY if an asynchronous operation is in progress.
+ */
+extern int16_t RFM69_SampleNoise(RFM69_t *rfm69);
+
+/**
+ * @brief Set the RSSI threshold used to start a reception in listen mode.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param dBm Threshold in dBm (-127 to 0).
+ * @return 0 on success, -1 if the threshold is out of range.
+ */
+extern int RFM69_SetRssiThreshold(RFM69_t *rfm69, int16_t dBm);
+
+/**
+ * @brief Get the RSSI threshold used in listen mode.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return Threshold in dBm.
+ */
+extern int16_t RFM69_GetRssiThreshold(RFM69_t *rfm69);
+
+/**
+ * @brief Get the noise floor tracked from the RFM69_SampleNoise() samples.
+ * The estimate follows a quieter channel quickly and a noisier channel slowly, so that short
+ * interferences don't raise it.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return Noise floor in dBm, 0 without samples.
+ */
+extern int16_t RFM69_GetNoiseFloorDBm(RFM69_t *rfm69);
+
+/**
+ * @brief Move the listen mode RSSI threshold to a margin above the noise floor.
+ * The threshold is only changed when it moves by at least RFM69_RSSI_THRESH_HYSTERESIS_DB.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param margin_db Margin above the noise floor.
+ * @param min_dbm Lowest threshold allowed (range limit).
+ * @param max_dbm Highest threshold allowed (wake-up on noise limit).
+ * @return 1 if the threshold was changed, 0 otherwise.
+ */
+extern uint8_t RFM69_AdaptRssiThreshold(RFM69_t *rfm69, int16_t margin_db, int16_t min_dbm, int16_t max_dbm);
+
+/**
+ * @brief Estimate the RX time that noise costs in listen mode, from the noise samples.
+ * With RFM69_LISTEN_CRITERIA_RSSI, each listen window with the channel above the RSSI threshold is
+ * extended up to TimeoutRssiThresh (RegRxTimeout2, 0x2B). With RFM69_LISTEN_CRITERIA_SYNC, this is the
+ * RX time avoided.
+ * Best-effort: the share of noisy windows is the share of RFM69_SampleNoise() samples above the
+ * threshold, so the samples must be spread over time (e.g. taken periodically, as the doorbell does
+ * every few minutes). Interferences shorter than the sampling period are only seen by chance.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return Estimated RX time on noise in milliseconds per hour, 0 without samples or outside of listen mode.
+ */
+extern uint32_t RFM69_GetNoiseRxMsPerHour(RFM69_t *rfm69);
+
+/**
+ * @brief Clear the link quality statistics.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ */
+extern void RFM69_ResetStats(RFM69_t *rfm69);
+
+/**
+ * @brief Print the link quality statistics (printf, UART).
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ */
+extern void RFM69_PrintStats(RFM69_t *rfm69);
+
+/**
+ * @brief Reset the operation timing counters.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ */
+extern void RFM69_ResetCounters(RFM69_t *rfm69);
+
+/**
+ * @brief Print the operation timing counters (printf, UART), operations never run are skipped.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
  */
-extern size_t RFM69_ReceiveMessage(RFM69_t *rfm69, uint8_t *buffer, size_t buffer_size);
+extern void RFM69_PrintCounters(RFM69_t *rfm69);
 
 #endif /* INC_RFM69_H_ */
@@ -0,0 +1,125 @@
+/**
+ * @file        rfm69_phy.h
+ * @brief       RFM69 PHY register values computed at compile time
+ * @author      Esteban CADIC
+ * @version     1.0
+ * @date        2025
+ * @copyright   MIT License
+ *
+ * The macros below turn physical parameters (bitrate, frequency deviation, carrier frequency
+ * and channel filter bandwidth) into register values. They are integer constant expressions:
+ * the register tables stay const in flash and no float code is pulled in the image.
+ * RFM69_PHY_CHECK() rejects invalid combinations at build time.
+ *
+ */
+
+#ifndef INC_RFM69_PHY_H_
+#define INC_RFM69_PHY_H_
+
+#include <stdint.h>
+
+
+/*------------------------------------------------------------------------------
+	CONSTANTS
+------------------------------------------------------------------------------*/
+
+/** Crystal oscillator frequency */
+#define RFM69_FXOSC			32000000UL
+
+/** Frequency synthesizer step is FXOSC / 2^19 */
+#define RFM69_FSTEP_SHIFT	19
+
+
+/*------------------------------------------------------------------------------
+	MACROS
+------------------------------------------------------------------------------*/
+
+#define RFM69_DIV_ROUND(x, y)	(((x) + (y) / 2) / (y))
+
+#define RFM69_MSB(x)	((uint8_t)(((x) >> 8) & 0xFF))
+#define RFM69_LSB(x)	((uint8_t)((x) & 0xFF))
+
+/** RegBitrate value for a bitrate in bps */
+#define RFM69_BITRATE_REG(bps)	((uint32_t)RFM69_DIV_ROUND(RFM69_FXOSC, (bps)))
+
+/** RegFdev value for a frequency deviation in Hz */
+#define RFM69_FDEV_REG(hz)		((uint32_t)RFM69_DIV_ROUND((uint64_t)(hz) << RFM69_FSTEP_SHIFT, RFM69_FXOSC))
+
+/** RegFrf value for a carrier frequency in Hz */
+#define RFM69_FRF_REG(hz)		((uint32_t)RFM69_DIV_ROUND((uint64_t)(hz) << RFM69_FSTEP_SHIFT, RFM69_FXOSC))
+
+/** FSK channel filter bandwidth for a RxBwMant code (0: 16, 1: 20, 2: 24) and a RxBwExp value */
+#define RFM69_RXBW_HZ(mant, exp)	(RFM69_FXOSC / ((16UL + 4 * (mant)) << ((exp) + 2)))
+
+/** RegRxBw value for a RxBwMant code and a RxBwExp value, DccFreq is left to its default (010) */
+#define RFM69_RXBW_CODE(mant, exp)	((uint8_t)(0x40 | ((mant) << 3) | (exp)))
+
+/** Channel filter bandwidth selected by a RegRxBw value */
+#define RFM69_RXBW_REG_HZ(reg)		RFM69_RXBW_HZ(((reg) >> 3) & 0x03, (reg) & 0x07)
+
+/** Smallest RegRxBw setting with a bandwidth greater or equal to hz */
+#define RFM69_RXBW_REG(hz) ( \
+		(hz) <= RFM69_RXBW_HZ(2, 7) ? RFM69_RXBW_CODE(2, 7) : \
+		(hz) <= RFM69_RXBW_HZ(1, 7) ? RFM69_RXBW_CODE(1, 7) : \
+		(hz) <= RFM69_RXBW_HZ(0, 7) ? RFM69_RXBW_CODE(0, 7) : \
+		(hz) <= RFM69_RXBW_HZ(2, 6) ? RFM69_RXBW_CODE(2, 6) : \
+		(hz) <= RFM69_RXBW_HZ(1, 6) ? RFM69_RXBW_CODE(1, 6) : \
+		(hz) <= RFM69_RXBW_HZ(0, 6) ? RFM69_RXBW_CODE(0, 6) : \
+		(hz) <= RFM69_RXBW_HZ(2, 5) ? RFM69_RXBW_CODE(2, 5) : \
+		(hz) <= RFM69_RXBW_HZ(1, 5) ? RFM69_RXBW_CODE(1, 5) : \
+		(hz) <= RFM69_RXBW_HZ(0, 5) ? RFM69_RXBW_CODE(0, 5) : \
+		(hz) <= RFM69_RXBW_HZ(2, 4) ? RFM69_RXBW_CODE(2, 4) : \
+		(hz) <= RFM69_RXBW_HZ(1, 4) ? RFM69_RXBW_CODE(1, 4) : \
+		(hz) <= RFM69_RXBW_HZ(0, 4) ? RFM69_RXBW_CODE(0, 4) : \
+		(hz) <= RFM69_RXBW_HZ(2, 3) ? RFM69_RXBW_CODE(2, 3) : \
+		(hz) <= RFM69_RXBW_HZ(1, 3) ? RFM69_RXBW_CODE(1, 3) : \
+		(hz) <= RFM69_RXBW_HZ(0, 3) ? RFM69_RXBW_CODE(0, 3) : \
+		(hz) <= RFM69_RXBW_HZ(2, 2) ? RFM69_RXBW_CODE(2, 2) : \
+		(hz) <= RFM69_RXBW_HZ(1, 2) ? RFM69_RXBW_CODE(1, 2) : \
+		(hz) <= RFM69_RXBW_HZ(0, 2) ? RFM69_RXBW_CODE(0, 2) : \
+		(hz) <= RFM69_RXBW_HZ(2, 1) ? RFM69_RXBW_CODE(2, 1) : \
+		(hz) <= RFM69_RXBW_HZ(1, 1) ? RFM69_RXBW_CODE(1, 1) : \
+		(hz) <= RFM69_RXBW_HZ(0, 1) ? RFM69_RXBW_CODE(0, 1) : \
+		(hz) <= RFM69_RXBW_HZ(2, 0) ? RFM69_RXBW_CODE(2, 0) : \
+		(hz) <= RFM69_RXBW_HZ(1, 0) ? RFM69_RXBW_CODE(1, 0) : \
+		RFM69_RXBW_CODE(0, 0))
+
+/**
+ * @brief Configuration table rows for RegBitrateMsb (0x03) to RegFrfLsb (0x09).
+ */
+#define RFM69_PHY_MODEM_CONFIG(bitrate, fdev, frf) \
+		{ 0x03, RFM69_MSB(RFM69_BITRATE_REG(bitrate)) }, \
+		{ 0x04, RFM69_LSB(RFM69_BITRATE_REG(bitrate)) }, \
+		{ 0x05, RFM69_MSB(RFM69_FDEV_REG(fdev)) }, \
+		{ 0x06, RFM69_LSB(RFM69_FDEV_REG(fdev)) }, \
+		{ 0x07, (uint8_t)((RFM69_FRF_REG(frf) >> 16) & 0xFF) }, \
+		{ 0x08, RFM69_MSB(RFM69_FRF_REG(frf)) }, \
+		{ 0x09, RFM69_LSB(RFM69_FRF_REG(frf)) }
+
+/**
+ * @brief Configuration table row for RegRxBw (0x19).
+ */
+#define RFM69_PHY_RXBW_CONFIG(rxbw) \
+		{ 0x19, RFM69_RXBW_REG(rxbw) }
+
+/**
+ * @brief Configuration table row for RegAfcBw (0x1A).
+ * The AFC must see the whole signal (Fdev + BR/2) even when it is shifted by the largest carrier offset.
+ */
+#define RFM69_PHY_AFCBW_CONFIG(bitrate, fdev, offset) \
+		{ 0x1A, RFM69_RXBW_REG((fdev) + (bitrate) / 2 + (offset)) }
+
+/**
+ * @brief Build time checks of a PHY configuration (RFM69HCW datasheet limits).
+ * Use at file scope: RFM69_PHY_CHECK(bitrate, fdev, frf, rxbw);
+ */
+#define RFM69_PHY_CHECK(bitrate, fdev, frf, rxbw) \
+		_Static_assert((bitrate) >= 1200 && (bitrate) <= 300000, "RFM69: FSK bitrate must be 1.2 to 300 kbps"); \
+		_Static_assert((fdev) >= 600 && (fdev) + (bitrate) / 2 <= 500000, "RFM69: Fdev must be >= 600 Hz and Fdev + BR/2 <= 500 kHz"); \
+		_Static_assert(4 * (fdev) >= (bitrate) && 2 * (fdev) <= 10 * (bitrate), "RFM69: modulation index 2*Fdev/BR must be 0.5 to 10"); \
+		_Static_assert(((frf) >= 290000000 && (frf) <= 340000000) || ((frf) >= 424000000 && (frf) <= 510000000) \
+				|| ((frf) >= 862000000 && (frf) <= 1020000000), "RFM69: carrier frequency out of the synthesizer bands"); \
+		_Static_assert((rxbw) <= 500000, "RFM69: channel filter bandwidth must be <= 500 kHz"); \
+		_Static_assert(RFM69_RXBW_REG_HZ(RFM69_RXBW_REG(rxbw)) >= (fdev) + (bitrate) / 2, "RFM69: channel filter narrower than Fdev + BR/2")
+
+#endif /* INC_RFM69_PHY_H_ */
@@ -53,8 +53,10 @@ void PendSV_Handler(void);
 void SysTick_Handler(void);
 void PVD_IRQHandler(void);
 void EXTI0_1_IRQHandler(void);
+void DMA1_Channel2_3_IRQHandler(void);
 void EXTI4_15_IRQHandler(void);
 /* USER CODE BEGIN EFP */
+void RTC_IRQHandler(void);
 
 /* USER CODE END EFP */
 
@@ -0,0 +1,88 @@
+/**
+ * @file        txpower.h
+ * @brief       Adaptive RFM69 output power control
+ * @author      Esteban CADIC
+ * @version     1.0
+ * @date        2025
+ * @copyright   MIT License
+ *
+ * The transmitter looks for the lowest output power that still reaches the receiver,
+ * using the RSSI reported back in the ACK frames. The power is lowered step by step while
+ * the receiver has margin, and raised quickly when an ACK is missed or the margin is gone.
+ * The learned power is kept in the data EEPROM.
+ *
+ */
+
+#ifndef INC_TXPOWER_H_
+#define INC_TXPOWER_H_
+
+#include "main.h"
+#include "rfm69.h"
+
+
+/*------------------------------------------------------------------------------
+	CONSTANTS
+------------------------------------------------------------------------------*/
+
+/** RSSI wanted at the receiver, about 20 dB above the RFM69 sensitivity with the default PHY */
+#define TXPOWER_TARGET_RSSI_DBM		-80
+/** Margin above the target needed before lowering the power (avoids oscillating around the target) */
+#define TXPOWER_HYSTERESIS_DB		3
+/** Power decrease after an ACK with enough margin */
+#define TXPOWER_STEP_DOWN_DB		1
+/** Power increase after a missed ACK */
+#define TXPOWER_STEP_UP_DB			6
+
+
+/*------------------------------------------------------------------------------
+	TYPE DEFINITIONS
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief Adaptive output power controller.
+ */
+typedef struct TXPOWER
+{
+	RFM69_t *rfm69; /**< RFM69 module controlled */
+
+	int8_t dbm; /**< Current output power */
+	int8_t min_dbm; /**< Lowest output power allowed */
+	int8_t max_dbm; /**< Highest output power allowed, used while nothing was learned */
+
+	uint32_t acks; /**< ACKs received */
+	uint32_t failures; /**< ACKs missed */
+} TXPOWER_t;
+
+
+/*------------------------------------------------------------------------------
+	DECLARATIONS
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief Initialize the controller and apply the output power learned before the last reset
+ * (the highest power if nothing was learned yet).
+ * 
+ * @param ctrl Pointer to the controller.
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param min_dbm Lowest output power allowed (must be supported by the module).
+ * @param max_dbm Highest output power allowed (must be supported by the module).
+ * @return 0 on success, RFM69_SetPowerDBm() error otherwise.
+ */
+extern int TXPOWER_Init(TXPOWER_t *ctrl, RFM69_t *rfm69, int8_t min_dbm, int8_t max_dbm);
+
+/**
+ * @brief Update the output power after an ACK.
+ * 
+ * @param ctrl Pointer to the controller.
+ * @param rssi RSSI of the acknowledged frame at the receiver, in dBm.
+ */
+extern void TXPOWER_Acknowledged(TXPOWER_t *ctrl, int8_t rssi);
+
+/**
+ * @brief Update the output power after a frame that was not acknowledged.
+ * 
+ * @param ctrl Pointer to the controller.
+ */
+extern void TXPOWER_Failed(TXPOWER_t *ctrl);
+
+#endif /* INC_TXPOWER_H_ */
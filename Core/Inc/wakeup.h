@@ -0,0 +1,44 @@
+/**
+ * @file        wakeup.h
+ * @brief       Periodic wake-up timer (RTC wake-up unit clocked by the LSI)
+ * @author      Esteban CADIC
+ * @version     1.0
+ * @date        2025
+ * @copyright   MIT License
+ *
+ */
+
+#ifndef INC_WAKEUP_H_
+#define INC_WAKEUP_H_
+
+#include "main.h"
+
+
+/*------------------------------------------------------------------------------
+	CONSTANTS
+------------------------------------------------------------------------------*/
+
+/** Longest wake-up period (16 bits counter clocked at 1 Hz) */
+#define WAKEUP_MAX_PERIOD_S	65536
+
+
+/*------------------------------------------------------------------------------
+	DECLARATIONS
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief Start the RTC wake-up timer. The RTC runs from the LSI in STOP mode and raises
+ * g_flag_wakeup (EXTI line 20) at every period.
+ * The LSI is not trimmed (26 to 56 kHz over process and temperature): the period is approximate.
+ *
+ * @param period_s Wake-up period in seconds (1 to WAKEUP_MAX_PERIOD_S).
+ * @return 0 on success, -1 if the period is out of range or the RTC doesn't respond.
+ */
+extern int WAKEUP_Init(uint32_t period_s);
+
+/**
+ * @brief RTC wake-up interrupt handler, to call from RTC_IRQHandler().
+ */
+extern void WAKEUP_IRQHandler(void);
+
+#endif /* INC_WAKEUP_H_ */
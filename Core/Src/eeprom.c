@@ -0,0 +1,55 @@
+/**
+ * @file        eeprom.c
+ * @brief       Data EEPROM driver
+ * @author      Esteban CADIC
+ * @version     1.0
+ * @date        2025
+ * @copyright   MIT License
+ *
+ */
+
+#include "eeprom.h"
+
+
+/*------------------------------------------------------------------------------
+	FONCTIONS
+------------------------------------------------------------------------------*/
+
+int EEPROM_Read(uint32_t offset, uint8_t *data, size_t size)
+{
+	if(offset + size > EEPROM_SIZE)
+		return -1;
+
+	for(size_t i = 0; i < size; i++)
+		data[i] = *(__IO uint8_t *)(DATA_EEPROM_BASE + offset + i);
+
+	return 0;
+}
+
+int EEPROM_Write(uint32_t offset, const uint8_t *data, size_t size)
+{
+	int ret = 0;
+
+	if(offset + size > EEPROM_SIZE)
+		return -1;
+
+	HAL_FLASHEx_DATAEEPROM_Unlock();
+
+	for(size_t i = 0; i < size; i++)
+	{
+		uint32_t address = DATA_EEPROM_BASE + offset + i;
+
+		if(*(__IO uint8_t *)address == data[i])
+			continue;
+
+		if(HAL_FLASHEx_DATAEEPROM_Program(FLASH_TYPEPROGRAMDATA_BYTE, address, data[i]) != HAL_OK)
+		{
+			ret = -2;
+			break;
+		}
+	}
+
+	HAL_FLASHEx_DATAEEPROM_Lock();
+
+	return ret;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file        frame.c
+ * @brief       Doorbell radio frame format
+ * @author      Esteban CADIC
+ * @version     1.0
+ * @date        2025
+ * @copyright   MIT License
+ *
+ */
+
+#include "frame.h"
+
+
+_Static_assert(sizeof(FRAME_Header_t) == 4, "Frame header must not be padded");
+
+
+/*------------------------------------------------------------------------------
+	FONCTIONS
+------------------------------------------------------------------------------*/
+
+uint8_t *FRAME_Pack(uint8_t *buffer, uint8_t dst, uint8_t src, uint8_t seq, uint8_t type)
+{
+	FRAME_Header_t *header = (FRAME_Header_t *)buffer;
+
+	header->dst = dst;
+	header->src = src;
+	header->seq = seq;
+	header->type = type;
+
+	return buffer + FRAME_HEADER_SIZE;
+}
+
+const FRAME_Header_t *FRAME_Unpack(const uint8_t *buffer, size_t length, const uint8_t **payload, size_t *payload_size)
+{
+	if(length < FRAME_HEADER_SIZE)
+		return NULL;
+
+	if(payload != NULL)
+		*payload = buffer + FRAME_HEADER_SIZE;
+
+	if(payload_size != NULL)
+		*payload_size = length - FRAME_HEADER_SIZE;
+
+	return (const FRAME_Header_t *)buffer;
+}
+
+FRAME_Peer_t *FRAME_GetPeer(FRAME_PeerTable_t *table, uint8_t src)
+{
+	for(size_t i = 0; i < FRAME_PEERS_SIZE; i++)
+	{
+		if(table->peers[i].valid && table->peers[i].src == src)
+			return &table->peers[i];
+	}
+
+	return NULL;
+}
+
+uint8_t FRAME_IsDuplicate(FRAME_PeerTable_t *table, const FRAME_Header_t *header)
+{
+	FRAME_Peer_t *peer = FRAME_GetPeer(table, header->src);
+
+	if(peer != NULL && peer->last_seq == header->seq)
+	{
+		table->duplicates++;
+		return 1;
+	}
+
+	// New peer: replace the oldest entry
+	if(peer == NULL)
+	{
+		peer = &table->peers[table->next];
+		table->next = (table->next + 1) % FRAME_PEERS_SIZE;
+
+		peer->src = header->src;
+		peer->valid = 1;
+		peer->freq_offset_hz = 0;
+	}
+
+	peer->last_seq = header->seq;
+	table->accepted++;
+
+	return 0;
+}
@@ -48,3 +48,14 @@ void LEDs_RXMessage(void)
 	}
 
 }
+
+void LEDs_Acknowledged(void)
+{
+	for(uint8_t i = 0; i < 2; i++)
+	{
+		LEDs_Reset();
+		HAL_Delay(100);
+		LEDs_SetColorBatteryVoltage();
+		HAL_Delay(100);
+	}
+}
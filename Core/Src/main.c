@@ -14,6 +14,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
 #include "adc.h"
+#include "dma.h"
 #include "spi.h"
 #include "usart.h"
 #include "gpio.h"
@@ -21,11 +22,16 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include <stdio.h>
+#include <string.h>
 
 #include "retarget.h"
 #include "rfm69.h"
 #include "leds.h"
 #include "batt.h"
+#include "eeprom.h"
+#include "frame.h"
+#include "txpower.h"
+#include "wakeup.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -36,19 +42,57 @@
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
 #define DOORBELL_CODE 				0x42
-#define DOORBELL_SEND_DURATION_MS	280
-
-/*
- * | ListenResolX | Min duration (ListenCoef = 1) | Max duration (ListenCoef = 255) |
- * |--------------|-------------------------------|---------------------------------|
- * | 01           | 64 us                         | 16 ms                           |
- * | 10           | 4.1 ms                        | 1.04 s                          |
- * | 11           | 0.26 s                        | 67 s                            |
+/** Address shared by the transmitter and the receiver of a doorbell pair */
+#define DOORBELL_NODE_ADDRESS		0x01
+#define DOORBELL_BROADCAST_ADDRESS	0xFF
+/** RFM69 PHY profile, must be the same on both boards */
+#define DOORBELL_PHY_PROFILE		RFM69_PHY_DEFAULT
+
+/** Number of receiver listen windows covered by each doorbell burst */
+#define DOORBELL_RX_WINDOWS			1
+
+/** Acknowledged delivery: the receiver answers, the transmitter stops its burst on the ACK */
+#define DOORBELL_ACK_EN				1
+/** Number of receiver listen windows covered by the burst when no ACK comes back */
+#define DOORBELL_ACK_RX_WINDOWS		2
+/** Extra time in the transmitter RX windows for the RFM69 RX startup and the MCU wake-up of the receiver */
+#define DOORBELL_ACK_MARGIN_MS		2
+
+/** Automatic frequency correction, the carrier offset of each peer is measured */
+#define DOORBELL_AFC_EN				1
+/**
+ * Channel filter of the receiver once centered on the last doorbell heard (0: PHY profile filter).
+ * Must contain Fdev + BR/2 of the PHY profile, see RFM69_SetRxBandwidth().
+ */
+#define DOORBELL_RX_BANDWIDTH_HZ	0
+
+/** Output power range, the transmitter learns the lowest power that still reaches the receiver (with ACK) */
+#define DOORBELL_TX_POWER_MIN_DBM	-2
+#define DOORBELL_TX_POWER_MAX_DBM	20
+
+/** Listen mode durations (64 us to 67 s, see RFM69_ComputeListenConfig() for the achievable values) */
+#define DOORBELL_LISTEN_IDLE_US		262144 // 0.26 s IDLE
+#define DOORBELL_LISTEN_RX_US		1024 // 1 ms RX
+/**
+ * Listen mode criteria. With RFM69_LISTEN_CRITERIA_SYNC, noise above the RSSI threshold no longer holds
+ * the radio in RX until TimeoutRssiThresh (0x2B), but the RX window is stretched to one packet so that a whole
+ * sync word of the burst always falls inside: only worth it with a fast PHY profile or a noisy band.
  */
-#define RFM69_LISTEN_RES_IDLE	3 // 0.26s
-#define RFM69_LISTEN_COEF_IDLE	1 // 1*0.26s = 0.26s IDLE
-#define RFM69_LISTEN_RES_RX		1 // 64 µS
-#define RFM69_LISTEN_COEF_RX	16 // 16*64 µs = 1024 µS RX
+#define DOORBELL_LISTEN_CRITERIA	RFM69_LISTEN_CRITERIA_RSSI
+/** Margin on the listen mode RX timeouts (sender clock, FS to TX ramp between burst packets) */
+#define DOORBELL_RX_TIMEOUT_MARGIN_US	2000
+/** Listen mode RSSI threshold, kept at a margin above the noise floor measured at each wake-up */
+#define DOORBELL_RSSI_MARGIN_DB		10
+#define DOORBELL_RSSI_THRESH_MIN_DBM	-100 // Close to the RFM69 sensitivity
+#define DOORBELL_RSSI_THRESH_MAX_DBM	-70 // Keeps the range of a few rooms in a noisy house
+/**
+ * Noise floor sampling period (RTC wake-up timer), on top of the sample taken after each doorbell event.
+ * 5 min: a few µJ per sample, the threshold still follows a slowly changing band. The RTC runs from
+ * the untrimmed LSI, the actual period can be off by -30 % to +50 %.
+ */
+#define DOORBELL_NOISE_SAMPLE_PERIOD_S	300
+/** Gap between two packets of a burst (FS to TX ramp, FIFO write), added to the sync criteria RX window */
+#define DOORBELL_BURST_GAP_US		500
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -61,8 +105,16 @@
 /* USER CODE BEGIN PV */
 uint8_t g_flag_switch = 0;
 uint8_t g_flag_message = 0;
+uint8_t g_flag_wakeup = 0;
 
 static uint8_t flag_sleep = 0;
+static uint32_t burst_duration_ms = 0;
+static uint32_t ack_window_ms = 0;
+static uint32_t ack_chunk_ms = 0;
+static uint32_t listen_rx_us = DOORBELL_LISTEN_RX_US;
+static uint8_t node_id = 0;
+static FRAME_PeerTable_t peers;
+static TXPOWER_t tx_power;
 static RFM69_t tx;
 
 /* USER CODE END PV */
@@ -73,6 +125,16 @@ void SystemClock_Config(void);
 static void SYS_Shutdown(void);
 static void MCU_Sleep(void);
 static void MCU_Wakeup(void);
+static uint8_t AES_KeyIsProvisioned(const uint8_t *key, size_t key_size);
+static void AES_WipeKey(uint8_t *key, size_t key_size);
+static uint8_t DOORBELL_GetNodeID(void);
+static size_t DOORBELL_SendWithAck(uint8_t *frame, size_t frame_size, uint8_t seq, uint8_t *acked, int8_t *ack_rssi);
+static uint8_t DOORBELL_WaitForAck(uint8_t seq, uint32_t timeout_ms, int8_t *ack_rssi);
+static void DOORBELL_SendAck(const FRAME_Header_t *header, int16_t rssi);
+static void DOORBELL_TrackPeerFrequency(uint8_t src, int32_t freq_offset_hz);
+static void DOORBELL_VerifyRadio(void);
+static void DOORBELL_SampleNoise(void);
+static uint8_t DOORBELL_LoadAESKey(void);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -88,8 +150,16 @@ int main(void)
 {
 
 	/* USER CODE BEGIN 1 */
-	uint8_t rx_buffer[1];
-	uint8_t tx_message[] = { DOORBELL_CODE };
+	uint8_t rx_buffer[FRAME_MAX_SIZE];
+	uint8_t tx_frame[FRAME_HEADER_SIZE + 1]; // Header + doorbell code
+	uint8_t tx_seq = 0;
+	size_t bytes_received = 0;
+	const FRAME_Header_t *rx_header = NULL;
+	const uint8_t *rx_payload = NULL;
+	size_t rx_payload_size = 0;
+	int16_t rx_rssi = 0;
+	int32_t rx_freq_offset_hz = 0;
+	RFM69_Listen_t listen = { 0 };
 
 	/* USER CODE END 1 */
 
@@ -111,6 +181,7 @@ int main(void)
 
 	/* Initialize all configured peripherals */
 	MX_GPIO_Init();
+	MX_DMA_Init();
 	MX_ADC_Init();
 	MX_SPI1_Init();
 	MX_USART1_UART_Init();
@@ -123,17 +194,69 @@ int main(void)
 	tx.cs.port = RFM69_CS_GPIO_Port;
 	tx.reset.pin = RFM69_RST_Pin;
 	tx.reset.port = RFM69_RST_GPIO_Port;
+	tx.dio0.pin = RFM69_DI0_IRQ_Pin;
+	tx.dio0.port = RFM69_DI0_IRQ_GPIO_Port;
 	tx.spi = &hspi1;
+	tx.spi_transport = RFM69_SPI_DMA;
+	tx.phy_profile = DOORBELL_PHY_PROFILE;
 	tx.high_power_en = 1;
+	tx.tx_irq_en = 1;
+	tx.listen_criteria = DOORBELL_LISTEN_CRITERIA;
+	tx.listen_payload_size = sizeof(tx_frame);
+	tx.rx_timeout_margin_us = DOORBELL_RX_TIMEOUT_MARGIN_US;
+
+	if(RFM69_Init(&tx) != RFM69_OK)
+		printf("RFM69_Init() failure!\n");
+
+	if(DOORBELL_LoadAESKey())
+		printf("RFM69 AES encryption enabled\n");
+	else
+		printf("No AES key in EEPROM, RFM69 encryption disabled!\n");
+
+	if(DOORBELL_AFC_EN && RFM69_SetAFC(&tx, 1) != RFM69_OK)
+		printf("RFM69_SetAFC() failure!\n");
+
+	// Packets for other doorbells are dropped by the RFM69 without waking up the MCU
+	RFM69_SetAddressFiltering(&tx, RFM69_ADDRESS_FILTERING_BROADCAST, DOORBELL_NODE_ADDRESS, DOORBELL_BROADCAST_ADDRESS);
 
-	RFM69_Init(&tx);
+	// Without ACK there is no feedback from the receiver: always the highest power
+	if(TXPOWER_Init(&tx_power, &tx, DOORBELL_ACK_EN ? DOORBELL_TX_POWER_MIN_DBM : DOORBELL_TX_POWER_MAX_DBM, DOORBELL_TX_POWER_MAX_DBM))
+		printf("TXPOWER_Init() failure!\n");
 
-	if(RFM69_SetPowerDBm(&tx, 20))
-		printf("RFM69_SetPowerDBm() to 20 dBm failure!\n");
+	// Sync criteria: the RX window must contain a whole packet period of the burst
+	if(tx.listen_criteria == RFM69_LISTEN_CRITERIA_SYNC && listen_rx_us < RFM69_GetPacketAirtimeUs(&tx, sizeof(tx_frame)) + DOORBELL_BURST_GAP_US)
+		listen_rx_us = RFM69_GetPacketAirtimeUs(&tx, sizeof(tx_frame)) + DOORBELL_BURST_GAP_US;
 
-	RFM69_ActiveListenMode(&tx, RFM69_LISTEN_RES_IDLE, RFM69_LISTEN_COEF_IDLE, RFM69_LISTEN_RES_RX, RFM69_LISTEN_COEF_RX);
+	if(RFM69_ActiveListenModeUs(&tx, DOORBELL_LISTEN_IDLE_US, listen_rx_us, &listen))
+		printf("RFM69_ActiveListenModeUs() failure!\n");
 
-	printf("RFM69 initialized!\n");
+	node_id = DOORBELL_GetNodeID();
+
+	// Continue the sequence so receivers don't drop the first frame after a reset
+	EEPROM_Read(EEPROM_TX_SEQ_ADDR, &tx_seq, 1);
+	tx_seq++;
+
+	// TX burst long enough to hit the receiver listen windows, with ACK the RX gaps can hide one:
+	// the ACK-less worst case covers more windows
+	burst_duration_ms = RFM69_GetListenBurstMs(&tx, DOORBELL_ACK_EN ? DOORBELL_ACK_RX_WINDOWS : DOORBELL_RX_WINDOWS, sizeof(tx_frame));
+
+	if(DOORBELL_ACK_EN)
+	{
+		// RX window long enough to catch a whole ACK started at any time, chunks of repeats twice as long
+		ack_window_ms = (2 * RFM69_GetPacketAirtimeUs(&tx, FRAME_HEADER_SIZE + 1) + 999) / 1000 + DOORBELL_ACK_MARGIN_MS;
+		ack_chunk_ms = 2 * ack_window_ms;
+	}
+
+	printf("RFM69 initialized! (node %02X, %lu SPI transactions, %lu ms burst, %d dBm)\n", node_id, tx.spi_transactions, burst_duration_ms, tx_power.dbm);
+	printf("PHY profile %d: %lu us and %lu uJ per packet\n", tx.phy_profile,
+			RFM69_GetPacketAirtimeUs(&tx, sizeof(tx_frame)),
+			RFM69_GetPacketEnergyUJ(&tx, sizeof(tx_frame), (uint16_t)(BATT_MeasureVoltage() * 1000)));
+	printf("Listen mode: %lu us idle, %lu us RX, %lu ppm duty cycle, %lu nA average\n",
+			listen.idle_us, listen.rx_us, listen.duty_cycle_ppm, listen.avg_current_na);
+
+	// Periodic noise floor samples, also without any doorbell traffic
+	if(WAKEUP_Init(DOORBELL_NOISE_SAMPLE_PERIOD_S))
+		printf("WAKEUP_Init() failure!\n");
 
 	// Go to stop mode
 	MCU_Sleep();
@@ -144,6 +267,48 @@ int main(void)
 	/* USER CODE BEGIN WHILE */
 	while(1)
 	{
+		if(g_flag_message) // Message in the RFM69 FIFO (DI0 IRQ)
+		{
+			// Disable RFM69 DI0 IRQ
+			HAL_NVIC_DisableIRQ(EXTI0_1_IRQn);
+
+			// Still at the wake-up clock: no UART output until MCU_Wakeup(), the receive counter leaves it untimed
+			bytes_received = RFM69_ReceiveMessage(&tx, rx_buffer, sizeof(rx_buffer) / sizeof(rx_buffer[0]), &rx_rssi);
+			rx_freq_offset_hz = RFM69_GetFrequencyOffsetHz(&tx);
+			rx_header = FRAME_Unpack(rx_buffer, bytes_received, &rx_payload, &rx_payload_size);
+
+			g_flag_message = 0;
+
+			// Enable RFM69 DI0 IRQ
+			HAL_NVIC_EnableIRQ(EXTI0_1_IRQn);
+
+			// Burst repeats are dropped before any ADC or LED work (and before any clock restore without ACK)
+			if(rx_header != NULL && FRAME_IsDuplicate(&peers, rx_header))
+			{
+				uint8_t ack_sent = 0;
+
+				// The first ACK may have been lost: without a new one the sender repeats for the whole burst
+				// and raises its power for nothing
+				if(DOORBELL_ACK_EN && rx_header->type == FRAME_TYPE_DOORBELL)
+				{
+					if(flag_sleep == 1)
+						MCU_Wakeup(); // The ACK burst is timed with the HAL tick
+
+					DOORBELL_SendAck(rx_header, rx_rssi);
+					ack_sent = 1;
+				}
+
+				rx_header = NULL;
+				bytes_received = 0;
+
+				if((flag_sleep == 1 || ack_sent) && g_flag_switch == 0 && g_flag_message == 0)
+				{
+					MCU_Sleep();
+					continue;
+				}
+			}
+		}
+
 		if(flag_sleep == 1) // If was in sleep mode
 			MCU_Wakeup();
 
@@ -152,52 +317,95 @@ int main(void)
 			LEDs_SetColorBatteryVoltage();
 
 			// Disable Listen mode
-			RFM69_DisableListenMode(&tx, RFM69_MODE_SLEEP);
-
-			// Changing DI0 mapping to nothing
-			RFM69_ChangeDI0Mapping(&tx, RFM69_DI0_TX_NONE);
+			if(RFM69_DisableListenMode(&tx, RFM69_MODE_SLEEP) != RFM69_OK)
+				printf("RFM69_DisableListenMode() failure!\n");
 
 			printf("Switch pressed! Sending the code...\n");
 
-			// Sending the code for DOORBELL_SEND_DURATION_MS
-			uint32_t tx_time = HAL_GetTick();
-			while(HAL_GetTick() - tx_time < DOORBELL_SEND_DURATION_MS)
-				RFM69_SendMessage(&tx, tx_message, sizeof(tx_message) / sizeof(tx_message[0]));
+			uint8_t *payload = FRAME_Pack(tx_frame, DOORBELL_NODE_ADDRESS, node_id, tx_seq, FRAME_TYPE_DOORBELL);
+			payload[0] = DOORBELL_CODE;
+
+			// Sending the code for the burst duration (or until acknowledged)
+			uint32_t spi_transactions = tx.spi_transactions;
+			uint32_t spi_time_us = tx.spi_time_us;
+			uint32_t burst_timeouts = tx.counters[RFM69_COUNTER_BURST].timeouts;
+			uint8_t acked = 0;
+			int8_t ack_rssi = 0;
+			int8_t power_dbm = tx_power.dbm;
+			size_t packets_sent;
+
+			if(DOORBELL_ACK_EN)
+				packets_sent = DOORBELL_SendWithAck(tx_frame, sizeof(tx_frame), tx_seq, &acked, &ack_rssi);
+			else
+			{
+				packets_sent = RFM69_SendBurst(&tx, tx_frame, sizeof(tx_frame), burst_duration_ms);
+				DOORBELL_VerifyRadio();
+			}
+
+			printf("%d packets sent at %d dBm (%lu SPI transactions, %lu us of SPI per packet)\n", packets_sent, power_dbm,
+					tx.spi_transactions - spi_transactions, packets_sent ? (tx.spi_time_us - spi_time_us) / packets_sent : 0);
+
+			// A module that stops answering mid-burst must not look like a successful send
+			if(tx.counters[RFM69_COUNTER_BURST].timeouts != burst_timeouts)
+			{
+				printf("RFM69 timeout during the burst!\n");
+				RFM69_PrintCounters(&tx);
+			}
+
+			if(acked)
+			{
+				printf("Acknowledged, received at %d dBm\n", ack_rssi);
+				TXPOWER_Acknowledged(&tx_power, ack_rssi);
+				LEDs_Acknowledged();
+			}
+			else if(DOORBELL_ACK_EN)
+			{
+				printf("Not acknowledged!\n");
+				TXPOWER_Failed(&tx_power);
+			}
+
+			EEPROM_Write(EEPROM_TX_SEQ_ADDR, &tx_seq, 1);
+			tx_seq++;
 
 			LEDs_Reset();
 
 			g_flag_switch = 0;
+			g_flag_message = 0; // DI0 IRQs raised by PacketSent
 
 			// Changing DI0 mapping to RX PayloadReady
-			RFM69_ChangeDI0Mapping(&tx, RFM69_DI0_RX_PAYLOAD_READY);
+			if(RFM69_ChangeDI0Mapping(&tx, RFM69_DI0_RX_PAYLOAD_READY) != RFM69_OK)
+				printf("RFM69_ChangeDI0Mapping() failure!\n");
 
 			// Enable Listen mode
-			RFM69_ActiveListenMode(&tx, RFM69_LISTEN_RES_IDLE, RFM69_LISTEN_COEF_IDLE, RFM69_LISTEN_RES_RX, RFM69_LISTEN_COEF_RX);
+			if(RFM69_ActiveListenModeUs(&tx, DOORBELL_LISTEN_IDLE_US, listen_rx_us, NULL))
+				printf("RFM69_ActiveListenModeUs() failure!\n");
 		}
 
-		if(g_flag_message) // Message in the RFM69 FIFO (DI0 IRQ)
+		if(bytes_received > 0)
 		{
-			// Disable RFM69 DI0 IRQ
-			HAL_NVIC_DisableIRQ(EXTI0_1_IRQn);
-
-			printf("Reading the message in the RFM69 FIFO\n");
-			size_t bytes_received = RFM69_ReceiveMessage(&tx, rx_buffer, sizeof(rx_buffer) / sizeof(rx_buffer[0]));
+			printf("%d bytes received : ", bytes_received);
+			for(size_t i = 0; i < bytes_received; i++)
+				printf("%02X ", rx_buffer[i]);
+			printf("\n");
 
-			if(bytes_received > 0)
+			// Doorbell code received
+			if(rx_header != NULL && rx_header->type == FRAME_TYPE_DOORBELL && rx_payload_size > 0 && rx_payload[0] == DOORBELL_CODE)
 			{
-				printf("%d bytes received : ", bytes_received);
-				for(size_t i = 0; i < bytes_received; i++)
-					printf("%02X ", rx_buffer[i]);
-				printf("\n");
+				printf("Doorbell from %02X (seq %d, %d dBm, %ld Hz), %lu repeats dropped so far\n", rx_header->src, rx_header->seq, rx_rssi, rx_freq_offset_hz, peers.duplicates);
+				RFM69_PrintStats(&tx);
+				RFM69_PrintCounters(&tx);
 
-				if(rx_buffer[0] == DOORBELL_CODE) // Doorbell code received
-					LEDs_RXMessage();
-			}
+				if(DOORBELL_AFC_EN)
+					DOORBELL_TrackPeerFrequency(rx_header->src, rx_freq_offset_hz);
 
-			g_flag_message = 0;
+				if(DOORBELL_ACK_EN)
+					DOORBELL_SendAck(rx_header, rx_rssi);
 
-			// Enable RFM69 DI0 IRQ
-			HAL_NVIC_EnableIRQ(EXTI0_1_IRQn);
+				LEDs_RXMessage();
+			}
+
+			bytes_received = 0;
+			rx_header = NULL;
 		}
 
 		float batt_voltage = BATT_MeasureVoltage();
@@ -206,7 +414,14 @@ int main(void)
 		if(batt_voltage < BATT_CRITICAL_VOLTAGE)
 			SYS_Shutdown();
 
+		// The doorbell traffic is over (or RTC wake-up): the channel RSSI is a noise sample
 		if(g_flag_message == 0 && g_flag_switch == 0)
+		{
+			g_flag_wakeup = 0;
+			DOORBELL_SampleNoise();
+		}
+
+		if(g_flag_message == 0 && g_flag_switch == 0 && g_flag_wakeup == 0)
 			MCU_Sleep();
 
 		/* USER CODE END WHILE */
@@ -277,7 +492,8 @@ static void SYS_Shutdown(void)
 	printf("Not enough battery to continue!\n");
 
 	printf("Stopping the RFM69...\n");
-	RFM69_DisableListenMode(&tx, RFM69_MODE_SLEEP);
+	if(RFM69_DisableListenMode(&tx, RFM69_MODE_SLEEP) != RFM69_OK)
+		printf("RFM69_DisableListenMode() failure!\n");
 
 	printf("Going to STM32 standby mode... Bye!\n");
 	HAL_SuspendTick();
@@ -286,13 +502,16 @@ static void SYS_Shutdown(void)
 
 /**
  * @brief Enable STM32 STOP mode.
- * The MCU will be woken up by a GPIO interrupt (RFM69 DI0 message received or switch pressed).
+ * The MCU will be woken up by a GPIO interrupt (RFM69 DI0 message received or switch pressed)
+ * or by the RTC wake-up timer (noise floor sample).
  */
 static void MCU_Sleep(void)
 {
-	flag_sleep = 1;
+	// UART is not usable when going back to sleep without restoring the clocks
+	if(flag_sleep == 0)
+		printf("Going to STM32 stop mode...\n");
 
-	printf("Going to STM32 stop mode...\n");
+	flag_sleep = 1;
 
 	HAL_SuspendTick();
 	HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
@@ -311,6 +530,250 @@ static void MCU_Wakeup(void)
 
 	flag_sleep = 0;
 }
+
+/**
+ * @brief Check if an AES key read from the data EEPROM was provisioned.
+ * 
+ * @param key Pointer to the key.
+ * @param key_size Size of the key.
+ * @return 1 if the key is provisioned, 0 if it is blank (all 0x00 or all 0xFF).
+ */
+static uint8_t AES_KeyIsProvisioned(const uint8_t *key, size_t key_size)
+{
+	uint8_t all_zero = 0x00;
+	uint8_t all_one = 0xFF;
+
+	for(size_t i = 0; i < key_size; i++)
+	{
+		all_zero |= key[i];
+		all_one &= key[i];
+	}
+
+	return all_zero != 0x00 && all_one != 0xFF;
+}
+
+/**
+ * @brief Erase a copy of the AES key from RAM.
+ * Written through a volatile pointer: a memset() of a buffer never read again is removed by the optimizer.
+ * 
+ * @param key Pointer to the key.
+ * @param key_size Size of the key.
+ */
+static void AES_WipeKey(uint8_t *key, size_t key_size)
+{
+	volatile uint8_t *p = key;
+
+	while(key_size--)
+		*p++ = 0;
+}
+
+/**
+ * @brief Get the source ID of this board, derived from the STM32 96-bit unique ID.
+ * 
+ * @return Source ID used in the frames sent by this board.
+ */
+static uint8_t DOORBELL_GetNodeID(void)
+{
+	uint32_t uid = HAL_GetUIDw0() ^ HAL_GetUIDw1() ^ HAL_GetUIDw2();
+
+	return (uid ^ (uid >> 8) ^ (uid >> 16) ^ (uid >> 24)) & 0xFF;
+}
+
+/**
+ * @brief Send a frame in chunks of repeats separated by RX windows, until it is acknowledged.
+ * Gives up after the full burst duration, like an unacknowledged burst.
+ * 
+ * @param frame Pointer to the frame.
+ * @param frame_size Size of the frame.
+ * @param seq Sequence number of the frame, expected in the ACK.
+ * @param acked Pointer to store 1 if an ACK was received, 0 otherwise.
+ * @param ack_rssi Pointer to store the RSSI of the frame at the receiver, reported in the ACK.
+ * @return Number of packets sent.
+ */
+static size_t DOORBELL_SendWithAck(uint8_t *frame, size_t frame_size, uint8_t seq, uint8_t *acked, int8_t *ack_rssi)
+{
+	size_t packets_sent = 0;
+	uint32_t time_entry = HAL_GetTick();
+
+	*acked = 0;
+
+	while(HAL_GetTick() - time_entry < burst_duration_ms)
+	{
+		packets_sent += RFM69_SendBurst(&tx, frame, frame_size, ack_chunk_ms);
+		DOORBELL_VerifyRadio();
+
+		if(DOORBELL_WaitForAck(seq, ack_window_ms, ack_rssi))
+		{
+			*acked = 1;
+			break;
+		}
+	}
+
+	return packets_sent;
+}
+
+/**
+ * @brief Listen for the ACK of a frame sent by this board.
+ * The MCU sleeps between the RFM69 polls, woken up by DIO0 (PayloadReady) or the SysTick.
+ * The RFM69 is put back in sleep mode afterwards.
+ * 
+ * @param seq Sequence number of the frame.
+ * @param timeout_ms RX window duration in ms.
+ * @param ack_rssi Pointer to store the RSSI reported in the ACK.
+ * @return 1 if the ACK was received, 0 on timeout.
+ */
+static uint8_t DOORBELL_WaitForAck(uint8_t seq, uint32_t timeout_ms, int8_t *ack_rssi)
+{
+	uint8_t buffer[FRAME_MAX_SIZE];
+	uint8_t acked = 0;
+	uint32_t time_entry = HAL_GetTick();
+	uint32_t elapsed_ms;
+
+	if(RFM69_ChangeDI0Mapping(&tx, RFM69_DI0_RX_PAYLOAD_READY) != RFM69_OK)
+		printf("RFM69_ChangeDI0Mapping() failure!\n");
+
+	// One reception per frame heard, until the ACK or the end of the RX window
+	while(!acked && (elapsed_ms = HAL_GetTick() - time_entry) < timeout_ms)
+	{
+		const uint8_t *payload;
+		size_t payload_size;
+		int status;
+
+		if(RFM69_StartReceive(&tx, buffer, sizeof(buffer), timeout_ms - elapsed_ms) != RFM69_OK)
+			break;
+
+		while((status = RFM69_Poll(&tx)) == RFM69_BUSY)
+		{
+			__disable_irq();
+
+			if(HAL_GPIO_ReadPin(tx.dio0.port, tx.dio0.pin) == GPIO_PIN_RESET)
+				__WFI();
+
+			__enable_irq();
+		}
+
+		if(status == RFM69_TIMEOUT)
+			break;
+
+		const FRAME_Header_t *header = FRAME_Unpack(buffer, RFM69_GetReceivedSize(&tx, NULL), &payload, &payload_size);
+
+		if(header != NULL && header->type == FRAME_TYPE_ACK && header->seq == seq && payload_size > 0)
+		{
+			*ack_rssi = (int8_t)payload[0];
+			acked = 1;
+		}
+	}
+
+	if(RFM69_SetMode(&tx, RFM69_MODE_SLEEP) != RFM69_OK)
+		printf("RFM69_SetMode() failure!\n");
+
+	return acked;
+}
+
+/**
+ * @brief Acknowledge a doorbell frame.
+ * The ACK is repeated for one chunk of repeats and one RX window of the transmitter,
+ * so that at least one whole ACK falls into one of its RX windows.
+ * 
+ * @param header Pointer to the header of the received frame.
+ * @param rssi RSSI of the received frame, reported to the transmitter for its output power control.
+ */
+static void DOORBELL_SendAck(const FRAME_Header_t *header, int16_t rssi)
+{
+	uint8_t ack_frame[FRAME_HEADER_SIZE + 1]; // Header + RSSI
+
+	uint8_t *payload = FRAME_Pack(ack_frame, DOORBELL_NODE_ADDRESS, node_id, header->seq, FRAME_TYPE_ACK);
+	payload[0] = (uint8_t)(int8_t)rssi;
+
+	if(RFM69_DisableListenMode(&tx, RFM69_MODE_SLEEP) != RFM69_OK)
+		printf("RFM69_DisableListenMode() failure!\n");
+
+	RFM69_SendBurst(&tx, ack_frame, sizeof(ack_frame), ack_chunk_ms + 2 * ack_window_ms);
+	DOORBELL_VerifyRadio();
+
+	if(RFM69_ChangeDI0Mapping(&tx, RFM69_DI0_RX_PAYLOAD_READY) != RFM69_OK)
+		printf("RFM69_ChangeDI0Mapping() failure!\n");
+	g_flag_message = 0; // DI0 IRQs raised by PacketSent
+
+	if(RFM69_ActiveListenModeUs(&tx, DOORBELL_LISTEN_IDLE_US, listen_rx_us, NULL))
+		printf("RFM69_ActiveListenModeUs() failure!\n");
+}
+
+/**
+ * @brief Store the carrier offset measured for a peer and, with a narrow channel filter,
+ * center the receiver on it (a doorbell receiver normally hears a single transmitter).
+ * 
+ * @param src Source ID of the peer.
+ * @param freq_offset_hz Carrier offset measured by the AFC.
+ */
+static void DOORBELL_TrackPeerFrequency(uint8_t src, int32_t freq_offset_hz)
+{
+	FRAME_Peer_t *peer = FRAME_GetPeer(&peers, src);
+
+	if(peer == NULL)
+		return;
+
+	peer->freq_offset_hz = freq_offset_hz;
+
+	if(DOORBELL_RX_BANDWIDTH_HZ == 0)
+		return;
+
+	if(RFM69_SetFrequencyCorrection(&tx, peer->freq_offset_hz) == 0)
+		printf("Centered on %02X, %lu Hz channel filter\n", src, RFM69_SetRxBandwidth(&tx, DOORBELL_RX_BANDWIDTH_HZ));
+}
+
+/**
+ * @brief Check the radio configuration after a TX burst, a brownout at high output power
+ * on a weak battery can corrupt the module registers.
+ */
+static void DOORBELL_VerifyRadio(void)
+{
+	size_t restored = RFM69_VerifyConfig(&tx);
+
+	if(restored > 0)
+		printf("RFM69 configuration corrupted, %u registers restored\n", restored);
+
+	// Module reset or corrupted RegPacketConfig2: the AES key registers may be cleared, encryption was
+	// left disabled. Without key in EEPROM the encryption is off on purpose.
+	if(!RFM69_AESIsEnabled(&tx) && DOORBELL_LoadAESKey())
+		printf("RFM69 AES key reloaded\n");
+}
+
+/**
+ * @brief Take a noise floor sample and move the listen mode RSSI threshold along.
+ */
+static void DOORBELL_SampleNoise(void)
+{
+	RFM69_SampleNoise(&tx);
+
+	if(RFM69_AdaptRssiThreshold(&tx, DOORBELL_RSSI_MARGIN_DB, DOORBELL_RSSI_THRESH_MIN_DBM, DOORBELL_RSSI_THRESH_MAX_DBM))
+		printf("RSSI threshold %d dBm (noise floor %d dBm)\n", RFM69_GetRssiThreshold(&tx), RFM69_GetNoiseFloorDBm(&tx));
+}
+
+/**
+ * @brief Load the AES key provisioned in data EEPROM (erased EEPROM = no key) in the RFM69.
+ * The RAM copy is wiped once written to the module.
+ * 
+ * @return 1 if the encryption is enabled, 0 without key.
+ */
+static uint8_t DOORBELL_LoadAESKey(void)
+{
+	uint8_t aes_key[EEPROM_AES_KEY_SIZE];
+	uint8_t provisioned;
+
+	EEPROM_Read(EEPROM_AES_KEY_ADDR, aes_key, sizeof(aes_key));
+
+	provisioned = AES_KeyIsProvisioned(aes_key, sizeof(aes_key));
+	if(provisioned && RFM69_SetAESKey(&tx, aes_key) != RFM69_OK)
+	{
+		printf("RFM69_SetAESKey() failure!\n");
+		provisioned = 0;
+	}
+
+	AES_WipeKey(aes_key, sizeof(aes_key));
+
+	return provisioned;
+}
 /* USER CODE END 4 */
 
 /**
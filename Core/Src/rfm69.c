@@ -10,6 +10,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "rfm69.h"
 
@@ -18,6 +19,113 @@
 	CONSTANTS
 ------------------------------------------------------------------------------*/
 
+/** Carrier frequency: 433.42 MHz */
+#define RFM69_PHY_FRF		433420000
+
+/** Largest carrier offset between two boards (2 x 20 ppm crystals at 433 MHz), covered by the AFC bandwidth */
+#define RFM69_PHY_FREQ_OFFSET	17000
+
+/** Default PHY: 10 kbps FSK, 20 kHz deviation, 25 kHz channel filter */
+#define RFM69_PHY_BITRATE	10000
+#define RFM69_PHY_FDEV		20000
+#define RFM69_PHY_RXBW		25000
+
+/** Long range PHY: 1.2 kbps FSK, 5 kHz deviation, 12.5 kHz channel filter */
+#define RFM69_PHY_LONG_RANGE_BITRATE	1200
+#define RFM69_PHY_LONG_RANGE_FDEV		5000
+#define RFM69_PHY_LONG_RANGE_RXBW		12500
+
+/** Fast PHY: 50 kbps FSK, 50 kHz deviation, 100 kHz channel filter */
+#define RFM69_PHY_FAST_BITRATE			50000
+#define RFM69_PHY_FAST_FDEV				50000
+#define RFM69_PHY_FAST_RXBW				100000
+
+/** Fastest PHY: 100 kbps FSK, 100 kHz deviation, 200 kHz channel filter */
+#define RFM69_PHY_FASTEST_BITRATE		100000
+#define RFM69_PHY_FASTEST_FDEV			100000
+#define RFM69_PHY_FASTEST_RXBW			200000
+
+RFM69_PHY_CHECK(RFM69_PHY_BITRATE, RFM69_PHY_FDEV, RFM69_PHY_FRF, RFM69_PHY_RXBW);
+RFM69_PHY_CHECK(RFM69_PHY_LONG_RANGE_BITRATE, RFM69_PHY_LONG_RANGE_FDEV, RFM69_PHY_FRF, RFM69_PHY_LONG_RANGE_RXBW);
+RFM69_PHY_CHECK(RFM69_PHY_FAST_BITRATE, RFM69_PHY_FAST_FDEV, RFM69_PHY_FRF, RFM69_PHY_FAST_RXBW);
+RFM69_PHY_CHECK(RFM69_PHY_FASTEST_BITRATE, RFM69_PHY_FASTEST_FDEV, RFM69_PHY_FRF, RFM69_PHY_FASTEST_RXBW);
+
+/** Asynchronous operation states */
+#define RFM69_STATE_IDLE			0
+#define RFM69_STATE_MODE			1 // Waiting for ModeReady
+#define RFM69_STATE_SEND_STANDBY	2 // Waiting for standby before the FIFO write
+#define RFM69_STATE_SEND_TX			3 // FIFO refill, waiting for PacketSent
+#define RFM69_STATE_SEND_SLEEP		4 // Waiting for sleep mode after the transmission
+#define RFM69_STATE_RECEIVE_READY	5 // Waiting for RX mode
+#define RFM69_STATE_RECEIVE			6 // Waiting for PayloadReady
+#define RFM69_STATE_RECEIVE_RESTART	7 // Waiting for RX mode after the FIFO read
+
+/** Timing counter of each asynchronous operation */
+static const uint8_t rfm69_op_counters[] = {
+		[RFM69_OP_MODE] = RFM69_COUNTER_MODE,
+		[RFM69_OP_SEND] = RFM69_COUNTER_SEND,
+		[RFM69_OP_RECEIVE] = RFM69_COUNTER_RECEIVE
+};
+
+static const char *const rfm69_counter_names[RFM69_COUNTER_COUNT] = { "mode", "send", "receive", "burst", "stream", "noise" };
+
+/** GetTimeUs() result when the SysTick is not a running 1 ms HAL tick (stop mode clock, tick suspended) */
+#define RFM69_TIME_INVALID	0xFFFFFFFF
+
+/** RegTestLna, RegTestPa1 and RegTestPa2 values (not shadowed, checked by RFM69_VerifyConfig()) */
+#define RFM69_TEST_LNA_NORMAL	0x1B // Normal sensitivity mode
+#define RFM69_TEST_PA1_NORMAL	0x55 // High power settings off
+#define RFM69_TEST_PA2_NORMAL	0x70
+#define RFM69_TEST_PA1_BOOST	0x5D // +20 dBm on PA_BOOST
+#define RFM69_TEST_PA2_BOOST	0x7C
+
+/** Maximum number of registers written in one burst transaction */
+#define RFM69_BURST_MAX_SIZE	16
+
+/** Listen mode resolutions in microseconds, indexed by ListenResolIdle/ListenResolRx */
+static const uint32_t rfm69_listen_resol_us[4] = { 0, 64, 4096, 262144 };
+
+/** Typical module current in RX (RFM69HCW datasheet) and in listen mode idle (RC oscillator only) */
+#define RFM69_RX_CURRENT_NA				16000000
+#define RFM69_LISTEN_IDLE_CURRENT_NA	1200
+
+/**
+ * @brief PHY profiles register tables (RegBitrate, RegFdev, RegFrf, RegRxBw and RegAfcBw).
+ * 
+ */
+static const uint8_t rfm69_phy_profiles[RFM69_PHY_COUNT][9][2] = {
+		[RFM69_PHY_DEFAULT] = {
+				RFM69_PHY_MODEM_CONFIG(RFM69_PHY_BITRATE, RFM69_PHY_FDEV, RFM69_PHY_FRF),
+				RFM69_PHY_RXBW_CONFIG(RFM69_PHY_RXBW),
+				RFM69_PHY_AFCBW_CONFIG(RFM69_PHY_BITRATE, RFM69_PHY_FDEV, RFM69_PHY_FREQ_OFFSET) },
+		[RFM69_PHY_LONG_RANGE] = {
+				RFM69_PHY_MODEM_CONFIG(RFM69_PHY_LONG_RANGE_BITRATE, RFM69_PHY_LONG_RANGE_FDEV, RFM69_PHY_FRF),
+				RFM69_PHY_RXBW_CONFIG(RFM69_PHY_LONG_RANGE_RXBW),
+				RFM69_PHY_AFCBW_CONFIG(RFM69_PHY_LONG_RANGE_BITRATE, RFM69_PHY_LONG_RANGE_FDEV, RFM69_PHY_FREQ_OFFSET) },
+		[RFM69_PHY_FAST] = {
+				RFM69_PHY_MODEM_CONFIG(RFM69_PHY_FAST_BITRATE, RFM69_PHY_FAST_FDEV, RFM69_PHY_FRF),
+				RFM69_PHY_RXBW_CONFIG(RFM69_PHY_FAST_RXBW),
+				RFM69_PHY_AFCBW_CONFIG(RFM69_PHY_FAST_BITRATE, RFM69_PHY_FAST_FDEV, RFM69_PHY_FREQ_OFFSET) },
+		[RFM69_PHY_FASTEST] = {
+				RFM69_PHY_MODEM_CONFIG(RFM69_PHY_FASTEST_BITRATE, RFM69_PHY_FASTEST_FDEV, RFM69_PHY_FRF),
+				RFM69_PHY_RXBW_CONFIG(RFM69_PHY_FASTEST_RXBW),
+				RFM69_PHY_AFCBW_CONFIG(RFM69_PHY_FASTEST_BITRATE, RFM69_PHY_FASTEST_FDEV, RFM69_PHY_FREQ_OFFSET) },
+		};
+
+/**
+ * @brief Typical TX current (mA) versus output power (dBm) from the RFM69HCW datasheet.
+ * Values between two points are interpolated.
+ * 
+ */
+static const int16_t rfm69_tx_current[][2] = {
+		{ -1, 16 },
+		{ 0, 20 },
+		{ 10, 33 },
+		{ 13, 45 },
+		{ 17, 95 },
+		{ 20, 130 },
+		};
+
 /**
  * @brief RFM69 base configuration.
  * See RFM69 datasheet for more details for each register.
@@ -26,25 +134,20 @@
 static const uint8_t rfm69_base_config[][2] = {
 		{ 0x01, 0x04 }, // RegOpMode: Standby Mode
 		{ 0x02, 0x00 }, // RegDataModul: Packet mode, FSK, no shaping
-		{ 0x03, 0x0C }, // RegBitrateMsb: 10 kbps
-		{ 0x04, 0x80 }, // RegBitrateLsb
-		{ 0x05, 0x01 }, // RegFdevMsb: 20 kHz
-		{ 0x06, 0x48 }, // RegFdevLsb
-		{ 0x07, 0x6C }, // RegFrfMsb: 433,42 MHz
-		{ 0x08, 0x5A }, // RegFrfMid
-		{ 0x09, 0xE1 }, // RegFrfLsb
+		RFM69_PHY_MODEM_CONFIG(RFM69_PHY_BITRATE, RFM69_PHY_FDEV, RFM69_PHY_FRF), // RegBitrate, RegFdev, RegFrf: default PHY
 		{ 0x18, 0x88 }, // RegLNA: 200 Ohm impedance, gain set by AGC loop
-		{ 0x19, 0x4C }, // RegRxBw: 25 kHz
-		{ 0x2C, 0x00 }, // RegPreambleMsb: 3 bytes preamble
+		RFM69_PHY_RXBW_CONFIG(RFM69_PHY_RXBW), // RegRxBw
+		RFM69_PHY_AFCBW_CONFIG(RFM69_PHY_BITRATE, RFM69_PHY_FDEV, RFM69_PHY_FREQ_OFFSET), // RegAfcBw
 		{ 0x25, 0x40 }, // RegDioMapping1: DIO0 PayloadReady
+		{ 0x2C, 0x00 }, // RegPreambleMsb: 3 bytes preamble
 		{ 0x2D, 0x03 }, // RegPreambleLsb
 		{ 0x2E, 0x88 }, // RegSyncConfig: Enable sync word, 2 bytes sync word
 		{ 0x2F, 0x20 }, // RegSyncValue1: 0x2025
 		{ 0x30, 0x25 }, // RegSyncValue2
-		{ 0x37, 0x50 }, // RegPacketConfig1: Fixed length, CRC on, whitening
-		{ 0x38, 0x01 }, // RegPayloadLength: 1 bytes payload
-		{ 0x3C, 0x80 }, // RegFifoThresh: TxStart on FifoNotEmpty, 0 bytes FifoThreshold
-		{ 0x58, 0x1B }, // RegTestLna: Normal sensitivity mode
+		{ 0x37, 0xD0 }, // RegPacketConfig1: Variable length, CRC on, whitening
+		{ 0x38, 0x40 }, // RegPayloadLength: 64 bytes max payload in RX
+		{ 0x3C, 0x80 | RFM69_FIFO_THRESHOLD }, // RegFifoThresh: TxStart on FifoNotEmpty, FIFO streaming threshold
+		{ 0x58, RFM69_TEST_LNA_NORMAL }, // RegTestLna: Normal sensitivity mode
 		};
 
 
@@ -54,102 +157,510 @@ static const uint8_t rfm69_base_config[][2] = {
 
 static inline void SPI_ChipSelect(RFM69_t *rfm69);
 static inline void SPI_ChipUnselect(RFM69_t *rfm69);
-static void SPI_SendData(RFM69_t *rfm69, uint8_t addr, uint8_t *data, uint16_t data_size);
+static void SPI_WaitForDMA(RFM69_t *rfm69);
+static void SPI_Transmit(RFM69_t *rfm69, const uint8_t *data, uint16_t data_size);
+static void SPI_Receive(RFM69_t *rfm69, uint8_t *data, uint16_t data_size);
+static void SPI_SendData(RFM69_t *rfm69, uint8_t addr, const uint8_t *data, uint16_t data_size);
 static void SPI_ReadData(RFM69_t *rfm69, uint8_t addr, uint8_t *data, uint16_t data_size);
 static void WriteRegister(RFM69_t *rfm69, uint8_t reg, uint8_t byte);
+static void WriteBurst(RFM69_t *rfm69, uint8_t reg, const uint8_t *data, uint16_t data_size);
+static void ReadBurst(RFM69_t *rfm69, uint8_t reg, uint8_t *data, uint16_t data_size);
 static uint8_t ReadRegister(RFM69_t *rfm69, uint8_t reg);
+static inline uint8_t IsShadowed(uint8_t reg);
+static inline uint8_t ReadBackMask(uint8_t reg);
+static inline uint8_t ShadowIsValid(RFM69_t *rfm69, uint8_t reg);
+static inline uint8_t ShadowMatches(RFM69_t *rfm69, uint8_t reg, uint8_t byte);
+static void ShadowUpdate(RFM69_t *rfm69, uint8_t reg, const uint8_t *data, uint16_t data_size);
+static uint8_t ReadRegisterCached(RFM69_t *rfm69, uint8_t reg);
 static uint8_t ReadMode(RFM69_t *rfm69);
-static void WaitForModeReady(RFM69_t *rfm69);
-static void WaitForPacketSent(RFM69_t *rfm69);
+static void WriteMode(RFM69_t *rfm69, uint8_t mode);
+static int WaitForModeReady(RFM69_t *rfm69);
+static uint8_t ModeIsReady(RFM69_t *rfm69);
+static uint8_t PacketIsSent(RFM69_t *rfm69);
+static void StartOperation(RFM69_t *rfm69, uint8_t operation, uint8_t state);
+static void SetOperationState(RFM69_t *rfm69, uint8_t state);
+static int FinishOperation(RFM69_t *rfm69, int status);
+static int WaitForOperation(RFM69_t *rfm69);
+static uint32_t GetTimeUs(void);
+static int CountOperation(RFM69_t *rfm69, uint8_t counter, uint32_t start_us, int status);
+static uint8_t ReceivePacket(RFM69_t *rfm69);
+static void RefillFIFO(RFM69_t *rfm69, uint8_t *message, size_t message_size, size_t *bytes_written, uint8_t irq_flags);
+static size_t ReadPayload(RFM69_t *rfm69, uint8_t *buffer, size_t buffer_size);
+static uint8_t WaitForPacketSent(RFM69_t *rfm69);
+static void WriteFIFO(RFM69_t *rfm69, uint8_t *message, size_t message_size, size_t chunk_size);
+static void WriteFIFOChunk(RFM69_t *rfm69, uint8_t *data, size_t data_size);
+static uint8_t PayloadSizeIsValid(RFM69_t *rfm69, size_t payload_size);
+static uint8_t TransmitPacket(RFM69_t *rfm69, uint8_t *message, size_t message_size);
+static void StatsAddRSSI(RFM69_t *rfm69, int16_t rssi);
+static int EncodeListenDuration(uint32_t duration_us, uint8_t round_up, uint8_t *resol, uint8_t *coef);
+static uint8_t RxTimeoutFromUs(RFM69_t *rfm69, uint32_t duration_us);
+static uint32_t RxTimeoutToUs(RFM69_t *rfm69, uint8_t timeout);
 
 
 /*------------------------------------------------------------------------------
 	FONCTIONS
 ------------------------------------------------------------------------------*/
 
-void RFM69_Init(RFM69_t *rfm69)
+int RFM69_Init(RFM69_t *rfm69)
 {
 	rfm69->_listen_mode_activated = 0;
+	rfm69->_afc_en = 0;
+	rfm69->_freq_correction_hz = 0;
+	rfm69->_freq_offset_hz = 0;
+	rfm69->_rssi_thresh_dbm = RFM69_RSSI_THRESH_DEFAULT_DBM;
+	rfm69->_op = RFM69_OP_NONE;
+	rfm69->_op_state = RFM69_STATE_IDLE;
+	rfm69->_op_status = RFM69_OK;
+
+	RFM69_ResetStats(rfm69);
+	RFM69_ResetCounters(rfm69);
+
+	// Module state is unknown, every register must be written
+	memset(rfm69->_shadow_valid, 0, sizeof(rfm69->_shadow_valid));
 
 	RFM69_SetCustomConfig(rfm69, rfm69_base_config, sizeof(rfm69_base_config) / 2);
 
+	// Only the registers differing from the default PHY are sent
+	if(RFM69_SetPhyProfile(rfm69, rfm69->phy_profile))
+		RFM69_SetPhyProfile(rfm69, RFM69_PHY_DEFAULT);
+
+	// Reset value of RegPaLevel: PA0, +13 dBm
+	rfm69->_power_dbm = 13;
+
 	// Disable OCP for high power devices, enable otherwise
 	WriteRegister(rfm69, 0x13, 0x0A | (rfm69->high_power_en ? 0x00 : 0x10));
+
+	// RegVersion: reads 0x00 or 0xFF if the module doesn't answer
+	rfm69->_op_status = ReadRegister(rfm69, 0x10) == 0x24 ? RFM69_OK : RFM69_ERROR;
+
+	return rfm69->_op_status;
 }
 
-void RFM69_SetCustomConfig(RFM69_t *rfm69, const uint8_t config[][2], size_t config_size)
+size_t RFM69_ResyncShadow(RFM69_t *rfm69)
 {
-	for(size_t i = 0; i < config_size; i++)
-		WriteRegister(rfm69, config[i][0], config[i][1]);
+	uint8_t regs[RFM69_SHADOW_SIZE];
+	size_t mismatches = 0;
+
+	ReadBurst(rfm69, RFM69_SHADOW_FIRST, regs, RFM69_SHADOW_SIZE);
+
+	for(uint8_t reg = RFM69_SHADOW_FIRST; reg <= RFM69_SHADOW_LAST; reg++)
+	{
+		uint8_t value = regs[reg - RFM69_SHADOW_FIRST];
+
+		if(!IsShadowed(reg))
+			continue;
+
+		if(ShadowIsValid(rfm69, reg) && !ShadowMatches(rfm69, reg, value))
+			mismatches++;
+
+		ShadowUpdate(rfm69, reg, &value, 1);
+	}
+
+	return mismatches;
 }
 
-void RFM69_SetMode(RFM69_t *rfm69, uint8_t mode)
+size_t RFM69_VerifyConfig(RFM69_t *rfm69)
 {
-	if((mode == ReadMode(rfm69)) || (mode > RFM69_MODE_RX))
-		return;
+	uint8_t regs[RFM69_SHADOW_SIZE];
+	uint8_t test[5]; // RegTestLna (0x58) to RegTestPa2 (0x5C)
+	uint8_t test_pa1 = rfm69->_power_dbm > 17 ? RFM69_TEST_PA1_BOOST : RFM69_TEST_PA1_NORMAL;
+	uint8_t test_pa2 = rfm69->_power_dbm > 17 ? RFM69_TEST_PA2_BOOST : RFM69_TEST_PA2_NORMAL;
+	size_t restored = 0;
+	uint8_t reg = RFM69_SHADOW_FIRST + 1; // RegOpMode changes on its own in listen mode
+
+	ReadBurst(rfm69, RFM69_SHADOW_FIRST, regs, RFM69_SHADOW_SIZE);
+	ReadBurst(rfm69, 0x58, test, sizeof(test));
+
+	// RegOpMode is set by the caller (and by the module in listen mode), the shadow only follows it
+	ShadowUpdate(rfm69, 0x01, &regs[0], 1);
+
+	// AesOn lost: the module was reset and its write-only key registers are cleared, AesOn must not
+	// be restored alone. Encryption stays off until the caller loads the key again, counted as restored.
+	if(ShadowIsValid(rfm69, 0x3D) && (rfm69->_shadow[0x3D - RFM69_SHADOW_FIRST] & 0x01) && (regs[0x3D - RFM69_SHADOW_FIRST] & 0x01) == 0)
+	{
+		rfm69->_shadow[0x3D - RFM69_SHADOW_FIRST] &= ~0x01;
+		restored++;
+	}
 
-	WriteRegister(rfm69, 0x01, mode << 2);
+	while(reg <= RFM69_SHADOW_LAST)
+	{
+		uint8_t first = reg;
+
+		// Registers never written (or read) by the driver have no expected value, read-only bits are
+		// left out of the comparison (ReadBackMask())
+		while(reg <= RFM69_SHADOW_LAST && ShadowIsValid(rfm69, reg) && !ShadowMatches(rfm69, reg, regs[reg - RFM69_SHADOW_FIRST]))
+			reg++;
+
+		if(reg == first)
+		{
+			reg++;
+			continue;
+		}
+
+		// Consecutive corrupted registers are restored from the shadow in one burst
+		WriteBurst(rfm69, first, &rfm69->_shadow[first - RFM69_SHADOW_FIRST], reg - first);
+		restored += reg - first;
+	}
+
+	// Test registers outside of the shadow range (never skipped by WriteRegister()), the ones in between are reserved
+	if(test[0] != RFM69_TEST_LNA_NORMAL)
+	{
+		WriteRegister(rfm69, 0x58, RFM69_TEST_LNA_NORMAL);
+		restored++;
+	}
+
+	if(rfm69->high_power_en && test[2] != test_pa1)
+	{
+		WriteRegister(rfm69, 0x5A, test_pa1);
+		restored++;
+	}
+
+	if(rfm69->high_power_en && test[4] != test_pa2)
+	{
+		WriteRegister(rfm69, 0x5C, test_pa2);
+		restored++;
+	}
+
+	return restored;
+}
+
+int RFM69_SetCustomConfig(RFM69_t *rfm69, const uint8_t config[][2], size_t config_size)
+{
+	uint8_t burst[RFM69_BURST_MAX_SIZE];
+	size_t i = 0;
+
+	// Nothing is written if the table has an invalid address (FIFO, out of the register map)
+	for(size_t j = 0; j < config_size; j++)
+	{
+		if(config[j][0] == 0x00 || config[j][0] > 0x7F)
+			return RFM69_ERROR;
+	}
+
+	while(i < config_size)
+	{
+		uint8_t reg = config[i][0];
+		uint16_t burst_size = 0;
+
+		// Skip registers already holding the requested value
+		if(ShadowMatches(rfm69, reg, config[i][1]))
+		{
+			i++;
+			continue;
+		}
+
+		// Merge consecutive register addresses into one auto-increment burst
+		do
+		{
+			burst[burst_size++] = config[i++][1];
+		} while(i < config_size && burst_size < RFM69_BURST_MAX_SIZE && config[i][0] == reg + burst_size);
+
+		// Unchanged registers at the end of the burst don't need to be sent
+		while(ShadowMatches(rfm69, reg + burst_size - 1, burst[burst_size - 1]))
+			burst_size--;
+
+		WriteBurst(rfm69, reg, burst, burst_size);
+	}
+
+	return RFM69_OK;
+}
+
+int RFM69_SetPhyProfile(RFM69_t *rfm69, uint8_t profile)
+{
+	if(profile >= RFM69_PHY_COUNT)
+		return -1;
+
+	RFM69_SetCustomConfig(rfm69, rfm69_phy_profiles[profile], sizeof(rfm69_phy_profiles[profile]) / 2);
+	rfm69->phy_profile = profile;
+	rfm69->_freq_correction_hz = 0;
+
+	return 0;
+}
+
+int RFM69_SetAESKey(RFM69_t *rfm69, const uint8_t *key)
+{
+	uint8_t packet_config_2 = ReadRegisterCached(rfm69, 0x3D);
+
+	if(key == NULL)
+	{
+		WriteRegister(rfm69, 0x3D, packet_config_2 & ~0x01); // RegPacketConfig2: AesOn off
+		return RFM69_OK;
+	}
+
+	// AES payloads are limited: a larger payload length would not be received
+	if(ReadRegisterCached(rfm69, 0x38) > RFM69_AES_MAX_PAYLOAD_SIZE)
+		return RFM69_ERROR;
+
+	// RegAesKey1 to RegAesKey16 (write-only, not shadowed), sent from the caller buffer: no copy left in RAM
+	WriteBurst(rfm69, 0x3E, key, RFM69_AES_KEY_SIZE);
+
+	WriteRegister(rfm69, 0x3D, packet_config_2 | 0x01); // RegPacketConfig2: AesOn
+
+	return RFM69_OK;
+}
+
+uint8_t RFM69_AESIsEnabled(RFM69_t *rfm69)
+{
+	return ReadRegisterCached(rfm69, 0x3D) & 0x01; // RegPacketConfig2: AesOn
+}
+
+int RFM69_SetAddressFiltering(RFM69_t *rfm69, uint8_t filtering, uint8_t node_address, uint8_t broadcast_address)
+{
+	if(filtering > RFM69_ADDRESS_FILTERING_BROADCAST)
+		return -1;
+
+	// RegPayloadLength is rewritten with its current value to merge everything in one burst
+	uint8_t address_config[][2] = {
+			{ 0x37, (ReadRegisterCached(rfm69, 0x37) & ~0x06) | (filtering << 1) }, // RegPacketConfig1: AddressFiltering
+			{ 0x38, ReadRegisterCached(rfm69, 0x38) }, // RegPayloadLength
+			{ 0x39, node_address }, // RegNodeAdrs
+			{ 0x3A, broadcast_address } // RegBroadcastAdrs
+	};
+
+	RFM69_SetCustomConfig(rfm69, address_config, sizeof(address_config) / 2);
+
+	return 0;
+}
+
+int RFM69_SetMode(RFM69_t *rfm69, uint8_t mode)
+{
+	if(rfm69->_op_state != RFM69_STATE_IDLE)
+		return RFM69_BUSY;
+
+	if(mode > RFM69_MODE_RX)
+		return RFM69_ERROR;
+
+	WriteMode(rfm69, mode);
+
+	return RFM69_OK;
 }
 
-void RFM69_ChangeDI0Mapping(RFM69_t *rfm69, uint8_t mapping)
+int RFM69_ChangeDI0Mapping(RFM69_t *rfm69, uint8_t mapping)
 {
+	if(mapping > 0x03)
+		return RFM69_ERROR;
+
 	WriteRegister(rfm69, 0x25, mapping << 6);
+
+	return RFM69_OK;
 }
 
-void RFM69_ActiveListenMode(RFM69_t *rfm69, uint8_t resol_idle, uint8_t coef_idle, uint8_t resol_rx, uint8_t coef_rx)
+int RFM69_ActiveListenMode(RFM69_t *rfm69, uint8_t resol_idle, uint8_t coef_idle, uint8_t resol_rx, uint8_t coef_rx)
 {
+	// Resolution 0 is reserved, a coefficient of 0 gives an empty window
+	if(resol_idle == 0 || resol_idle > 3 || resol_rx == 0 || resol_rx > 3 || coef_idle == 0 || coef_rx == 0)
+		return RFM69_ERROR;
+
 	uint8_t reg_listen_1 = 0x02 << 1; // ListenEnd: 10, resume Listen Mode
+	reg_listen_1 |= (rfm69->listen_criteria & 0x01) << 3; // ListenCriteria
 	reg_listen_1 |= (resol_rx & 0x03) << 4; // ListenResolRx
 	reg_listen_1 |= (resol_idle & 0x03) << 6; // ListenResolIdle
 
+	uint32_t rx_us = rfm69_listen_resol_us[resol_rx & 0x03] * coef_rx;
+	size_t payload_size = rfm69->listen_payload_size ? rfm69->listen_payload_size : ReadRegisterCached(rfm69, 0x38);
+	uint32_t rssi_timeout_us = 2 * RFM69_GetPacketAirtimeUs(rfm69, payload_size);
+
 	uint8_t listen_mode_config[][2] = {
 			{ 0x01, 0x44 }, // RegOpMode: ListenOn, Standby Mode
 			{ 0x0D, reg_listen_1 }, // RegListen1
 			{ 0x0E, coef_idle }, // RegListen2
 			{ 0x0F, coef_rx }, // RegListen3
-			{ 0x29, 0xB4 }, // RssiThreshold: -90 dB
-			{ 0x2A, 0x3E }, // TimeoutRxStart: 62*16*(1/10kbps) = 100 ms
-			{ 0x2B, 0x3E } // TimeoutRssiThresh: 100 ms
+			{ 0x29, -2 * rfm69->_rssi_thresh_dbm }, // RssiThreshold: -RssiThreshold / 2 [dBm]
+			{ 0x2A, RxTimeoutFromUs(rfm69, rx_us + rfm69->rx_timeout_margin_us) }, // TimeoutRxStart: RX window
+			{ 0x2B, RxTimeoutFromUs(rfm69, rssi_timeout_us + rfm69->rx_timeout_margin_us) } // TimeoutRssiThresh: two packets
 	};
 
 	RFM69_SetCustomConfig(rfm69, listen_mode_config, sizeof(listen_mode_config) / 2);
 
 	rfm69->_listen_mode_activated = 1;
+
+	return RFM69_OK;
+}
+
+int RFM69_ComputeListenConfig(uint32_t idle_us, uint32_t rx_us, RFM69_Listen_t *listen)
+{
+	if(EncodeListenDuration(idle_us, 0, &listen->resol_idle, &listen->coef_idle)
+			|| EncodeListenDuration(rx_us, 1, &listen->resol_rx, &listen->coef_rx))
+		return -1;
+
+	listen->idle_us = rfm69_listen_resol_us[listen->resol_idle] * listen->coef_idle;
+	listen->rx_us = rfm69_listen_resol_us[listen->resol_rx] * listen->coef_rx;
+
+	uint64_t period_us = (uint64_t)listen->idle_us + listen->rx_us;
+
+	listen->duty_cycle_ppm = (uint32_t)(((uint64_t)listen->rx_us * 1000000 + period_us / 2) / period_us);
+	listen->avg_current_na = (uint32_t)(((uint64_t)listen->rx_us * RFM69_RX_CURRENT_NA
+			+ (uint64_t)listen->idle_us * RFM69_LISTEN_IDLE_CURRENT_NA + period_us / 2) / period_us);
+
+	return 0;
+}
+
+int RFM69_ActiveListenModeUs(RFM69_t *rfm69, uint32_t idle_us, uint32_t rx_us, RFM69_Listen_t *listen)
+{
+	RFM69_Listen_t config;
+
+	if(RFM69_ComputeListenConfig(idle_us, rx_us, &config))
+		return -1;
+
+	if(RFM69_ActiveListenMode(rfm69, config.resol_idle, config.coef_idle, config.resol_rx, config.coef_rx) != RFM69_OK)
+		return -1;
+
+	if(listen != NULL)
+		*listen = config;
+
+	return 0;
+}
+
+uint32_t RFM69_GetListenPeriodUs(RFM69_t *rfm69)
+{
+	uint8_t reg_listen_1 = ReadRegisterCached(rfm69, 0x0D);
+	uint32_t idle_us = rfm69_listen_resol_us[(reg_listen_1 >> 6) & 0x03] * ReadRegisterCached(rfm69, 0x0E);
+	uint32_t rx_us = rfm69_listen_resol_us[(reg_listen_1 >> 4) & 0x03] * ReadRegisterCached(rfm69, 0x0F);
+
+	return idle_us + rx_us;
+}
+
+uint32_t RFM69_GetListenBurstMs(RFM69_t *rfm69, uint8_t rx_windows, size_t payload_size)
+{
+	uint32_t burst_us = rx_windows * RFM69_GetListenPeriodUs(rfm69) + 2 * RFM69_GetPacketAirtimeUs(rfm69, payload_size);
+
+	return (burst_us + 999) / 1000;
 }
 
-void RFM69_DisableListenMode(RFM69_t *rfm69, uint8_t mode)
+int RFM69_DisableListenMode(RFM69_t *rfm69, uint8_t mode)
 {
 	if(mode > RFM69_MODE_RX)
-		return;
+		return RFM69_ERROR;
 
 	WriteRegister(rfm69, 0x01, 0x20 | mode << 2); // RegOpMode: ListenAbort, selected mode
 	WriteRegister(rfm69, 0x01, mode << 2); // RegOpMode: selected mode
 
 	rfm69->_listen_mode_activated = 0;
+
+	return WaitForModeReady(rfm69);
 }
 
-void RFM69_SendMessage(RFM69_t *rfm69, uint8_t *message, size_t message_size)
+int RFM69_SendMessage(RFM69_t *rfm69, uint8_t *message, size_t message_size)
 {
-	RFM69_SetMode(rfm69, RFM69_MODE_STANDBY);
-	WaitForModeReady(rfm69);
+	int status = RFM69_StartSend(rfm69, message, message_size);
+
+	if(status != RFM69_OK)
+		return status == RFM69_BUSY ? RFM69_BUSY : RFM69_ERROR;
+
+	return WaitForOperation(rfm69);
+}
+
+size_t RFM69_SendBurst(RFM69_t *rfm69, uint8_t *message, size_t message_size, uint32_t duration_ms)
+{
+	size_t packets_sent = 0;
+	uint32_t time_entry = HAL_GetTick();
+	uint32_t start_us = GetTimeUs();
+	int status;
+
+	if(rfm69->_op_state != RFM69_STATE_IDLE)
+	{
+		rfm69->_op_status = RFM69_BUSY;
+		return 0;
+	}
+
+	if(message_size == 0 || !PayloadSizeIsValid(rfm69, message_size))
+	{
+		rfm69->_op_status = RFM69_ERROR;
+		return 0;
+	}
+
+	WriteMode(rfm69, RFM69_MODE_STANDBY);
+	status = WaitForModeReady(rfm69);
 
 	// Clear FIFO
 	WriteRegister(rfm69, 0x28, 0x10);
 
-	if(message_size == 0)
-		return;
+	if(rfm69->tx_irq_en)
+		RFM69_ChangeDI0Mapping(rfm69, RFM69_DI0_TX_PACKET_SENT);
 
-	// Send message to RFM69 FIFO
-	SPI_ChipSelect(rfm69);
-	SPI_SendData(rfm69, 0x00 | 0x80, message, message_size);
-	SPI_ChipUnselect(rfm69);
+	// Lock the synthesizer once for the whole burst
+	if(status == RFM69_OK)
+	{
+		WriteMode(rfm69, RFM69_MODE_FS);
+		status = WaitForModeReady(rfm69);
+	}
+
+	while(status == RFM69_OK && HAL_GetTick() - time_entry < duration_ms)
+	{
+		if(!TransmitPacket(rfm69, message, message_size))
+		{
+			status = RFM69_TIMEOUT;
+			break;
+		}
+
+		packets_sent++;
+
+		// Back to FS between packets: PacketSent is cleared but the PLL stays locked
+		WriteMode(rfm69, RFM69_MODE_FS);
+	}
+
+	WriteMode(rfm69, RFM69_MODE_SLEEP);
+	if(WaitForModeReady(rfm69) != RFM69_OK)
+		status = RFM69_TIMEOUT;
+
+	rfm69->_op_status = CountOperation(rfm69, RFM69_COUNTER_BURST, start_us, status);
+
+	return packets_sent;
+}
+
+uint32_t RFM69_GetPacketAirtimeUs(RFM69_t *rfm69, size_t payload_size)
+{
+	uint32_t bitrate_reg = (ReadRegisterCached(rfm69, 0x03) << 8) | ReadRegisterCached(rfm69, 0x04);
+	uint32_t preamble_size = (ReadRegisterCached(rfm69, 0x2C) << 8) | ReadRegisterCached(rfm69, 0x2D);
+	uint8_t sync_config = ReadRegisterCached(rfm69, 0x2E);
+	uint8_t packet_config = ReadRegisterCached(rfm69, 0x37);
+	uint32_t packet_size;
+
+	// AesOn: the payload is sent in 16 bytes blocks, the address byte stays in clear
+	if(ReadRegisterCached(rfm69, 0x3D) & 0x01)
+	{
+		size_t address_size = (packet_config & 0x06) && payload_size > 0 ? 1 : 0;
+
+		payload_size = address_size + (payload_size - address_size + RFM69_AES_KEY_SIZE - 1) / RFM69_AES_KEY_SIZE * RFM69_AES_KEY_SIZE;
+	}
+
+	packet_size = preamble_size + payload_size;
+
+	if(sync_config & 0x80) // SyncOn
+		packet_size += ((sync_config >> 3) & 0x07) + 1;
+
+	if(packet_config & 0x80) // Variable length: length byte
+		packet_size += 1;
+
+	if(packet_config & 0x10) // CrcOn
+		packet_size += 2;
+
+	// Bit duration is BitRate / FXOSC
+	return ((uint64_t)packet_size * 8 * bitrate_reg) / (RFM69_FXOSC / 1000000);
+}
 
-	// Transmit the message and wait for it
-	RFM69_SetMode(rfm69, RFM69_MODE_TX);
-	WaitForPacketSent(rfm69);
+uint32_t RFM69_GetPacketEnergyUJ(RFM69_t *rfm69, size_t payload_size, uint16_t supply_mv)
+{
+	const size_t points = sizeof(rfm69_tx_current) / sizeof(rfm69_tx_current[0]);
+	int16_t current_ma = rfm69_tx_current[0][1];
+	uint32_t charge_uc;
+
+	// Interpolate the TX current for the current output power
+	for(size_t i = 1; i < points; i++)
+	{
+		if(rfm69->_power_dbm <= rfm69_tx_current[i - 1][0])
+			break;
+
+		int16_t dbm_range = rfm69_tx_current[i][0] - rfm69_tx_current[i - 1][0];
+		int16_t ma_range = rfm69_tx_current[i][1] - rfm69_tx_current[i - 1][1];
+		int16_t dbm = rfm69->_power_dbm < rfm69_tx_current[i][0] ? rfm69->_power_dbm : rfm69_tx_current[i][0];
 
-	RFM69_SetMode(rfm69, RFM69_MODE_SLEEP);
-	WaitForModeReady(rfm69);
+		current_ma = rfm69_tx_current[i - 1][1] + (ma_range * (dbm - rfm69_tx_current[i - 1][0])) / dbm_range;
+	}
+
+	// mA * us = nC
+	charge_uc = (current_ma * RFM69_GetPacketAirtimeUs(rfm69, payload_size) + 500) / 1000;
+
+	return (charge_uc * supply_mv + 500) / 1000;
 }
 
 int RFM69_SetPowerDBm(RFM69_t *rfm69, int8_t dBm)
@@ -176,8 +687,8 @@ int RFM69_SetPowerDBm(RFM69_t *rfm69, int8_t dBm)
 			WriteRegister(rfm69, 0x11, 0x40 | power_level);
 
 			// Disable high power settings
-			WriteRegister(rfm69, 0x5A, 0x55);
-			WriteRegister(rfm69, 0x5C, 0x70);
+			WriteRegister(rfm69, 0x5A, RFM69_TEST_PA1_NORMAL);
+			WriteRegister(rfm69, 0x5C, RFM69_TEST_PA2_NORMAL);
 		}
 		else if(dBm > 13 && dBm <= 17)
 		{
@@ -188,8 +699,8 @@ int RFM69_SetPowerDBm(RFM69_t *rfm69, int8_t dBm)
 			WriteRegister(rfm69, 0x11, 0x60 | power_level);
 
 			// Disable high power settings
-			WriteRegister(rfm69, 0x5A, 0x55);
-			WriteRegister(rfm69, 0x5C, 0x70);
+			WriteRegister(rfm69, 0x5A, RFM69_TEST_PA1_NORMAL);
+			WriteRegister(rfm69, 0x5C, RFM69_TEST_PA2_NORMAL);
 		}
 		else
 		{
@@ -200,8 +711,8 @@ int RFM69_SetPowerDBm(RFM69_t *rfm69, int8_t dBm)
 			WriteRegister(rfm69, 0x11, 0x60 | power_level);
 
 			// Enable high power settings
-			WriteRegister(rfm69, 0x5A, 0x5D);
-			WriteRegister(rfm69, 0x5C, 0x7C);
+			WriteRegister(rfm69, 0x5A, RFM69_TEST_PA1_BOOST);
+			WriteRegister(rfm69, 0x5C, RFM69_TEST_PA2_BOOST);
 		}
 	}
 	else // High power not enabled
@@ -213,63 +724,608 @@ int RFM69_SetPowerDBm(RFM69_t *rfm69, int8_t dBm)
 		WriteRegister(rfm69, 0x11, 0x80 | power_level);
 	}
 
+	rfm69->_power_dbm = dBm;
+
 	return 0;
 }
 
-size_t RFM69_ReceiveMessage(RFM69_t *rfm69, uint8_t *buffer, size_t buffer_size)
+size_t RFM69_ReceiveMessage(RFM69_t *rfm69, uint8_t *buffer, size_t buffer_size, int16_t *rssi)
 {
-	size_t bytes_read = 0;
+	if(RFM69_StartReceive(rfm69, buffer, buffer_size, 0) != RFM69_OK || WaitForOperation(rfm69) != RFM69_OK)
+		return 0;
+
+	return RFM69_GetReceivedSize(rfm69, rssi);
+}
+
+int RFM69_StartSetMode(RFM69_t *rfm69, uint8_t mode)
+{
+	if(rfm69->_op_state != RFM69_STATE_IDLE)
+		return RFM69_BUSY;
+
+	if(mode > RFM69_MODE_RX)
+		return -1;
+
+	WriteMode(rfm69, mode);
+	StartOperation(rfm69, RFM69_OP_MODE, RFM69_STATE_MODE);
+
+	return RFM69_OK;
+}
+
+int RFM69_StartSend(RFM69_t *rfm69, uint8_t *message, size_t message_size)
+{
+	if(rfm69->_op_state != RFM69_STATE_IDLE)
+		return RFM69_BUSY;
+
+	if(message_size == 0 || !PayloadSizeIsValid(rfm69, message_size))
+		return -1;
+
+	rfm69->_op_data = message;
+	rfm69->_op_size = message_size;
+	rfm69->_op_bytes = 0;
+
+	WriteMode(rfm69, RFM69_MODE_STANDBY);
+	StartOperation(rfm69, RFM69_OP_SEND, RFM69_STATE_SEND_STANDBY);
+
+	return RFM69_OK;
+}
+
+int RFM69_StartReceive(RFM69_t *rfm69, uint8_t *buffer, size_t buffer_size, uint32_t timeout_ms)
+{
+	if(rfm69->_op_state != RFM69_STATE_IDLE)
+		return RFM69_BUSY;
+
+	rfm69->_op_data = buffer;
+	rfm69->_op_size = buffer_size;
+	rfm69->_op_bytes = 0;
+	rfm69->_op_rx_timeout_ms = timeout_ms;
+
 	if(ReadMode(rfm69) != RFM69_MODE_RX && !rfm69->_listen_mode_activated)
 	{
-		RFM69_SetMode(rfm69, RFM69_MODE_RX);
-		WaitForModeReady(rfm69);
+		WriteMode(rfm69, RFM69_MODE_RX);
+		StartOperation(rfm69, RFM69_OP_RECEIVE, RFM69_STATE_RECEIVE_READY);
 	}
+	else
+		StartOperation(rfm69, RFM69_OP_RECEIVE, RFM69_STATE_RECEIVE);
+
+	return RFM69_OK;
+}
+
+int RFM69_Poll(RFM69_t *rfm69)
+{
+	uint8_t irq_flags;
 
-	// If PayloadReady flag is set
-	if(ReadRegister(rfm69, 0x28) & 0x04 || rfm69->_listen_mode_activated)
+	switch(rfm69->_op_state)
 	{
-		printf("PayloadReady flag is set \n");
-		RFM69_SetMode(rfm69, RFM69_MODE_STANDBY);
+	case RFM69_STATE_IDLE:
+		return rfm69->_op_status;
 
-		// Read until FIFO is empty or buffer size is reached
-		while((ReadRegister(rfm69, 0x28) & 0x40) && (bytes_read < buffer_size))
+	case RFM69_STATE_MODE:
+		if(ModeIsReady(rfm69))
+			return FinishOperation(rfm69, RFM69_OK);
+		break;
+
+	case RFM69_STATE_SEND_STANDBY:
+		if(!ModeIsReady(rfm69))
+			break;
+
+		// Clear FIFO
+		WriteRegister(rfm69, 0x28, 0x10);
+
+		if(rfm69->tx_irq_en)
+			RFM69_ChangeDI0Mapping(rfm69, RFM69_DI0_TX_PACKET_SENT);
+
+		// Fill the FIFO and start the transmission, the rest of a long message is streamed
+		rfm69->_op_bytes = rfm69->_op_size < RFM69_FIFO_SIZE - 1 ? rfm69->_op_size : RFM69_FIFO_SIZE - 1;
+		WriteFIFO(rfm69, rfm69->_op_data, rfm69->_op_size, rfm69->_op_bytes);
+
+		WriteMode(rfm69, RFM69_MODE_TX);
+		SetOperationState(rfm69, RFM69_STATE_SEND_TX);
+		break;
+
+	case RFM69_STATE_SEND_TX:
+		if(rfm69->_op_bytes < rfm69->_op_size)
 		{
-			buffer[bytes_read] = ReadRegister(rfm69, 0x00);
-			bytes_read++;
+			irq_flags = ReadRegister(rfm69, 0x28);
+			RefillFIFO(rfm69, rfm69->_op_data, rfm69->_op_size, &rfm69->_op_bytes, irq_flags);
+		}
+		else if(PacketIsSent(rfm69))
+		{
+			WriteMode(rfm69, RFM69_MODE_SLEEP);
+			SetOperationState(rfm69, RFM69_STATE_SEND_SLEEP);
+		}
+		break;
+
+	case RFM69_STATE_SEND_SLEEP:
+	case RFM69_STATE_RECEIVE_RESTART:
+		if(ModeIsReady(rfm69))
+			return FinishOperation(rfm69, RFM69_OK);
+		break;
+
+	case RFM69_STATE_RECEIVE_READY:
+		if(!ModeIsReady(rfm69))
+			break;
+
+		SetOperationState(rfm69, RFM69_STATE_RECEIVE);
+		// Fall through - the FIFO is checked at least once before the reception timeout applies
+
+	case RFM69_STATE_RECEIVE:
+		if(ReceivePacket(rfm69))
+		{
+			// Back to RX after the FIFO read, listen mode resumes by itself
+			if(rfm69->_listen_mode_activated)
+				return FinishOperation(rfm69, RFM69_OK);
+
+			WriteMode(rfm69, RFM69_MODE_RX);
+			SetOperationState(rfm69, RFM69_STATE_RECEIVE_RESTART);
 		}
+		break;
+	}
 
-		if(!rfm69->_listen_mode_activated)
+	if(HAL_GetTick() - rfm69->_op_tick >= (rfm69->_op_state == RFM69_STATE_RECEIVE ? rfm69->_op_rx_timeout_ms : RFM69_TIMEOUT_MS))
+	{
+		// The end of the reception window is not a module failure
+		if(rfm69->_op_state == RFM69_STATE_RECEIVE)
 		{
-			RFM69_SetMode(rfm69, RFM69_MODE_RX);
-			WaitForModeReady(rfm69);
+			if(rfm69->_listen_mode_activated)
+				rfm69->stats.false_wakes++;
+
+			return FinishOperation(rfm69, RFM69_NO_PACKET);
 		}
+
+		// A module stuck in TX keeps its PA on: back to sleep, even without ModeReady
+		if(rfm69->_op == RFM69_OP_SEND)
+			WriteMode(rfm69, RFM69_MODE_SLEEP);
+
+		return FinishOperation(rfm69, RFM69_TIMEOUT);
 	}
 
-	return bytes_read;
+	return RFM69_BUSY;
 }
 
+int RFM69_GetStatus(RFM69_t *rfm69)
+{
+	return rfm69->_op_status;
+}
 
-/**
- * @brief Activate the SPI chip select pin of the RFM69 module.
- * 
- * @param rfm69 Pointer to the RFM69 structure.
- */
-static inline void SPI_ChipSelect(RFM69_t *rfm69)
+size_t RFM69_GetReceivedSize(RFM69_t *rfm69, int16_t *rssi)
 {
-	HAL_GPIO_WritePin(rfm69->cs.port, rfm69->cs.pin, GPIO_PIN_RESET);
+	if(rssi != NULL && rfm69->_op_bytes > 0)
+		*rssi = rfm69->_op_rssi;
+
+	return rfm69->_op_bytes;
 }
 
-/**
- * @brief Deactivate the SPI chip select pin of the RFM69 module.
- * 
- * @param rfm69 Pointer to the RFM69 structure.
- */
-static inline void SPI_ChipUnselect(RFM69_t *rfm69)
+int RFM69_SetAFC(RFM69_t *rfm69, uint8_t enable)
 {
-	HAL_GPIO_WritePin(rfm69->cs.port, rfm69->cs.pin, GPIO_PIN_SET);
+	if(enable > 1)
+		return RFM69_ERROR;
+
+	// RegAfcFei: AfcAutoOn (AFC each time RX starts), AfcAutoclearOn (new estimate for every packet)
+	WriteRegister(rfm69, 0x1E, enable ? 0x0C : 0x00);
+
+	rfm69->_afc_en = enable;
+
+	return RFM69_OK;
 }
 
-/**
+int32_t RFM69_GetFrequencyOffsetHz(RFM69_t *rfm69)
+{
+	return rfm69->_freq_offset_hz;
+}
+
+int RFM69_SetFrequencyCorrection(RFM69_t *rfm69, int32_t offset_hz)
+{
+	if(offset_hz < -RFM69_FREQ_CORRECTION_MAX_HZ || offset_hz > RFM69_FREQ_CORRECTION_MAX_HZ)
+		return -1;
+
+	int32_t offset_reg = (int32_t)(((int64_t)offset_hz << RFM69_FSTEP_SHIFT) / (int64_t)RFM69_FXOSC);
+	uint32_t frf_reg = RFM69_FRF_REG(RFM69_PHY_FRF) + offset_reg;
+
+	uint8_t frf_config[][2] = {
+			{ 0x07, (frf_reg >> 16) & 0xFF }, // RegFrfMsb
+			{ 0x08, (frf_reg >> 8) & 0xFF }, // RegFrfMid
+			{ 0x09, frf_reg & 0xFF } // RegFrfLsb
+	};
+
+	RFM69_SetCustomConfig(rfm69, frf_config, sizeof(frf_config) / 2);
+
+	rfm69->_freq_correction_hz = offset_hz;
+
+	return 0;
+}
+
+uint32_t RFM69_SetRxBandwidth(RFM69_t *rfm69, uint32_t bandwidth_hz)
+{
+	uint32_t bitrate = RFM69_FXOSC / ((ReadRegisterCached(rfm69, 0x03) << 8) | ReadRegisterCached(rfm69, 0x04));
+	uint32_t fdev = (((ReadRegisterCached(rfm69, 0x05) << 8) | ReadRegisterCached(rfm69, 0x06)) * (uint64_t)RFM69_FXOSC) >> RFM69_FSTEP_SHIFT;
+	uint8_t rx_bw = RFM69_RXBW_REG(bandwidth_hz);
+
+	// The channel filter must keep the whole signal
+	if(RFM69_RXBW_REG_HZ(rx_bw) < fdev + bitrate / 2)
+		return 0;
+
+	WriteRegister(rfm69, 0x19, rx_bw);
+
+	return RFM69_RXBW_REG_HZ(rx_bw);
+}
+
+size_t RFM69_ReceiveStream(RFM69_t *rfm69, uint8_t *buffer, size_t buffer_size, uint32_t timeout_ms)
+{
+	uint8_t packet_config = ReadRegisterCached(rfm69, 0x37);
+	size_t payload_length = ReadRegisterCached(rfm69, 0x38);
+	size_t bytes_read = 0;
+	uint32_t time_entry = HAL_GetTick();
+	uint32_t start_us = GetTimeUs();
+	uint8_t irq_flags = 0;
+	int16_t rssi;
+	int status = RFM69_OK;
+
+	if(rfm69->_listen_mode_activated)
+	{
+		rfm69->_op_status = RFM69_ERROR;
+		return 0;
+	}
+
+	if(ReadMode(rfm69) != RFM69_MODE_RX)
+	{
+		WriteMode(rfm69, RFM69_MODE_RX);
+		status = WaitForModeReady(rfm69);
+	}
+
+	// Wait for the first byte: the sync word was received
+	while(status == RFM69_OK && (ReadRegister(rfm69, 0x28) & 0x40) == 0)
+	{
+		if(HAL_GetTick() - time_entry >= timeout_ms)
+			status = RFM69_NO_PACKET;
+	}
+
+	if(status != RFM69_OK)
+	{
+		rfm69->_op_status = CountOperation(rfm69, RFM69_COUNTER_STREAM, start_us, status);
+		return 0;
+	}
+
+	rssi = -(int16_t)ReadRegister(rfm69, 0x24) / 2;
+
+	if(packet_config & 0x80) // Variable length: the first FIFO byte is the payload length
+		payload_length = ReadRegister(rfm69, 0x00);
+
+	time_entry = HAL_GetTick();
+
+	while(bytes_read < payload_length)
+	{
+		size_t chunk_size = 0;
+
+		irq_flags = ReadRegister(rfm69, 0x28);
+
+		// The last bytes are only read with PayloadReady, once the CRC is checked
+		if(irq_flags & 0x04) // PayloadReady: the rest of the packet is in the FIFO
+			chunk_size = payload_length - bytes_read;
+		else if((irq_flags & 0x20) && payload_length - bytes_read > RFM69_FIFO_THRESHOLD) // FifoLevel
+			chunk_size = RFM69_FIFO_THRESHOLD;
+		else if(HAL_GetTick() - time_entry >= timeout_ms) // CRC error (FIFO cleared by the module) or signal lost
+			break;
+
+		if(bytes_read + chunk_size > buffer_size)
+			break;
+
+		if(chunk_size != 0)
+			ReadBurst(rfm69, 0x00, buffer + bytes_read, chunk_size);
+
+		bytes_read += chunk_size;
+	}
+
+	if(bytes_read > 0 && bytes_read == payload_length)
+	{
+		// CrcAutoClearOff: PayloadReady is also raised on CRC errors, CrcOk tells them apart
+		if((packet_config & 0x08) && !(irq_flags & 0x02))
+			rfm69->stats.crc_failures++;
+		else
+		{
+			rfm69->stats.packets++;
+			StatsAddRSSI(rfm69, rssi);
+			rfm69->_op_status = CountOperation(rfm69, RFM69_COUNTER_STREAM, start_us, RFM69_OK);
+
+			return bytes_read;
+		}
+	}
+
+	// Incomplete or invalid packet: drop it and restart the reception
+	WriteMode(rfm69, RFM69_MODE_STANDBY);
+	WriteRegister(rfm69, 0x28, 0x10);
+	WriteMode(rfm69, RFM69_MODE_RX);
+	status = WaitForModeReady(rfm69) == RFM69_OK ? RFM69_NO_PACKET : RFM69_TIMEOUT;
+	rfm69->_op_status = CountOperation(rfm69, RFM69_COUNTER_STREAM, start_us, status);
+
+	return 0;
+}
+
+int RFM69_SetMaxPayloadSize(RFM69_t *rfm69, uint8_t size)
+{
+	if((ReadRegisterCached(rfm69, 0x3D) & 0x01) && size > RFM69_AES_MAX_PAYLOAD_SIZE)
+		return -1;
+
+	WriteRegister(rfm69, 0x38, size); // RegPayloadLength
+
+	return 0;
+}
+
+int RFM69_SetCrcFailureCount(RFM69_t *rfm69, uint8_t enable)
+{
+	if(enable > 1)
+		return RFM69_ERROR;
+
+	uint8_t packet_config_1 = ReadRegisterCached(rfm69, 0x37);
+
+	// RegPacketConfig1: CrcAutoClearOff
+	WriteRegister(rfm69, 0x37, enable ? (packet_config_1 | 0x08) : (packet_config_1 & ~0x08));
+
+	return RFM69_OK;
+}
+
+int16_t RFM69_SampleNoise(RFM69_t *rfm69)
+{
+	uint8_t listen_mode_activated = rfm69->_listen_mode_activated;
+	uint8_t mode = ReadMode(rfm69);
+	uint32_t time_entry;
+	uint32_t start_us = GetTimeUs();
+	int16_t rssi;
+	int status;
+
+	if(rfm69->_op_state != RFM69_STATE_IDLE)
+	{
+		rfm69->_op_status = RFM69_BUSY;
+		return 0;
+	}
+
+	if(listen_mode_activated)
+		status = RFM69_DisableListenMode(rfm69, RFM69_MODE_RX);
+	else
+	{
+		WriteMode(rfm69, RFM69_MODE_RX);
+		status = WaitForModeReady(rfm69);
+	}
+
+	// RegRssiConfig: RssiStart, then wait for RssiDone
+	WriteRegister(rfm69, 0x23, 0x01);
+	time_entry = HAL_GetTick();
+	while(status == RFM69_OK && (ReadRegister(rfm69, 0x23) & 0x02) == 0)
+	{
+		if(HAL_GetTick() - time_entry >= RFM69_TIMEOUT_MS)
+			status = RFM69_TIMEOUT;
+	}
+
+	rssi = -(int16_t)ReadRegister(rfm69, 0x24) / 2;
+
+	if(rfm69->stats.noise_samples == 0)
+		rfm69->_noise_floor_q4 = rssi * 16;
+	else if(rssi * 16 < rfm69->_noise_floor_q4)
+		rfm69->_noise_floor_q4 += (rssi * 16 - rfm69->_noise_floor_q4) / 2; // Quieter: follow quickly
+	else
+		rfm69->_noise_floor_q4 += (rssi * 16 - rfm69->_noise_floor_q4) / 16; // Noisier: follow slowly
+
+	rfm69->stats.noise_samples++;
+	if(rssi > rfm69->_rssi_thresh_dbm)
+		rfm69->stats.noise_above_thresh++;
+
+	if(listen_mode_activated)
+	{
+		// Listen registers are unchanged, only ListenOn must be set again
+		WriteMode(rfm69, RFM69_MODE_STANDBY);
+		WriteRegister(rfm69, 0x01, 0x44); // RegOpMode: ListenOn, Standby Mode
+		rfm69->_listen_mode_activated = 1;
+	}
+	else
+		WriteMode(rfm69, mode);
+
+	rfm69->_op_status = CountOperation(rfm69, RFM69_COUNTER_NOISE, start_us, status);
+
+	return rssi;
+}
+
+int RFM69_SetRssiThreshold(RFM69_t *rfm69, int16_t dBm)
+{
+	if(dBm < -127 || dBm > 0)
+		return -1;
+
+	WriteRegister(rfm69, 0x29, -2 * dBm); // RegRssiThresh
+	rfm69->_rssi_thresh_dbm = dBm;
+
+	return 0;
+}
+
+int16_t RFM69_GetRssiThreshold(RFM69_t *rfm69)
+{
+	return rfm69->_rssi_thresh_dbm;
+}
+
+int16_t RFM69_GetNoiseFloorDBm(RFM69_t *rfm69)
+{
+	if(rfm69->stats.noise_samples == 0)
+		return 0;
+
+	return rfm69->_noise_floor_q4 / 16;
+}
+
+uint8_t RFM69_AdaptRssiThreshold(RFM69_t *rfm69, int16_t margin_db, int16_t min_dbm, int16_t max_dbm)
+{
+	int16_t thresh_dbm;
+
+	if(rfm69->stats.noise_samples == 0)
+		return 0;
+
+	thresh_dbm = RFM69_GetNoiseFloorDBm(rfm69) + margin_db;
+
+	if(thresh_dbm < min_dbm)
+		thresh_dbm = min_dbm;
+	else if(thresh_dbm > max_dbm)
+		thresh_dbm = max_dbm;
+
+	// Hysteresis, unless a limit is reached
+	if(thresh_dbm == rfm69->_rssi_thresh_dbm
+			|| (thresh_dbm > min_dbm && thresh_dbm < max_dbm
+					&& thresh_dbm > rfm69->_rssi_thresh_dbm - RFM69_RSSI_THRESH_HYSTERESIS_DB
+					&& thresh_dbm < rfm69->_rssi_thresh_dbm + RFM69_RSSI_THRESH_HYSTERESIS_DB))
+		return 0;
+
+	return RFM69_SetRssiThreshold(rfm69, thresh_dbm) == 0;
+}
+
+uint32_t RFM69_GetNoiseRxMsPerHour(RFM69_t *rfm69)
+{
+	RFM69_Stats_t *stats = &rfm69->stats;
+	uint8_t reg_listen_1 = ReadRegisterCached(rfm69, 0x0D);
+	uint32_t rx_us = rfm69_listen_resol_us[(reg_listen_1 >> 4) & 0x03] * ReadRegisterCached(rfm69, 0x0F);
+	uint32_t period_us = RFM69_GetListenPeriodUs(rfm69);
+
+	// Noise above the threshold holds the radio in RX until TimeoutRssiThresh
+	uint32_t timeout_us = RxTimeoutToUs(rfm69, ReadRegisterCached(rfm69, 0x2B));
+
+	if(stats->noise_samples == 0 || period_us == 0 || timeout_us <= rx_us)
+		return 0;
+
+	// Windows per hour x share of noisy windows x RX extension of a noisy window
+	uint64_t extra_us = (uint64_t)3600000000UL / period_us * (timeout_us - rx_us) * stats->noise_above_thresh / stats->noise_samples;
+
+	return (uint32_t)(extra_us / 1000);
+}
+
+void RFM69_ResetStats(RFM69_t *rfm69)
+{
+	memset(&rfm69->stats, 0, sizeof(rfm69->stats));
+}
+
+void RFM69_ResetCounters(RFM69_t *rfm69)
+{
+	memset(rfm69->counters, 0, sizeof(rfm69->counters));
+}
+
+void RFM69_PrintStats(RFM69_t *rfm69)
+{
+	RFM69_Stats_t *stats = &rfm69->stats;
+
+	printf("RFM69 link: %lu packets, %lu CRC failures, %lu false wakes\n", stats->packets, stats->crc_failures, stats->false_wakes);
+
+	if(stats->rssi_count > 0)
+		printf("RFM69 RSSI: min %d dBm, max %d dBm, mean %ld dBm\n", stats->rssi_min, stats->rssi_max, stats->rssi_sum / (int32_t)stats->rssi_count);
+
+	if(stats->noise_samples > 0)
+		printf("RFM69 noise: %lu/%lu samples above threshold, ~%lu ms/h of RX %s\n", stats->noise_above_thresh, stats->noise_samples,
+				RFM69_GetNoiseRxMsPerHour(rfm69), rfm69->listen_criteria == RFM69_LISTEN_CRITERIA_SYNC ? "avoided" : "spent on noise");
+}
+
+void RFM69_PrintCounters(RFM69_t *rfm69)
+{
+	for(uint8_t i = 0; i < RFM69_COUNTER_COUNT; i++)
+	{
+		RFM69_Counter_t *counter = &rfm69->counters[i];
+
+		uint32_t timed = counter->calls - counter->untimed;
+
+		if(counter->calls == 0)
+			continue;
+
+		printf("RFM69 %s: %lu calls (%lu untimed), %lu timeouts, min %lu us, max %lu us, mean %lu us\n", rfm69_counter_names[i],
+				counter->calls, counter->untimed, counter->timeouts, counter->min_us, counter->max_us,
+				timed ? (uint32_t)(counter->total_us / timed) : 0);
+	}
+}
+
+
+/**
+ * @brief Activate the SPI chip select pin of the RFM69 module.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ */
+static inline void SPI_ChipSelect(RFM69_t *rfm69)
+{
+	rfm69->spi_transactions++;
+	rfm69->_spi_start_us = GetTimeUs();
+	HAL_GPIO_WritePin(rfm69->cs.port, rfm69->cs.pin, GPIO_PIN_RESET);
+}
+
+/**
+ * @brief Deactivate the SPI chip select pin of the RFM69 module.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ */
+static inline void SPI_ChipUnselect(RFM69_t *rfm69)
+{
+	uint32_t end_us;
+
+	HAL_GPIO_WritePin(rfm69->cs.port, rfm69->cs.pin, GPIO_PIN_SET);
+
+	end_us = GetTimeUs();
+	if(rfm69->_spi_start_us != RFM69_TIME_INVALID && end_us != RFM69_TIME_INVALID)
+		rfm69->spi_time_us += end_us - rfm69->_spi_start_us;
+}
+
+/**
+ * @brief Sleep until the current SPI DMA transfer is complete.
+ * Interrupts are masked around the state check so the DMA complete interrupt cannot be missed before WFI.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ */
+static void SPI_WaitForDMA(RFM69_t *rfm69)
+{
+	__disable_irq();
+
+	while(HAL_SPI_GetState(rfm69->spi) != HAL_SPI_STATE_READY)
+	{
+		__WFI(); // Woken up by the pending DMA interrupt even when masked
+		__enable_irq();
+		__disable_irq();
+	}
+
+	__enable_irq();
+}
+
+/**
+ * @brief Transmit raw bytes on the SPI bus, the chip select must already be active.
+ * DMA is used if selected in the RFM69 structure and the transfer is at least RFM69_DMA_MIN_SIZE bytes.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param data Pointer to the data to send.
+ * @param data_size Size of the data to send.
+ */
+static void SPI_Transmit(RFM69_t *rfm69, const uint8_t *data, uint16_t data_size)
+{
+	// The HAL prototypes are not const-qualified, the buffer is only read
+	if(rfm69->spi_transport == RFM69_SPI_DMA && data_size >= RFM69_DMA_MIN_SIZE)
+	{
+		if(HAL_SPI_Transmit_DMA(rfm69->spi, (uint8_t *)data, data_size) == HAL_OK)
+		{
+			SPI_WaitForDMA(rfm69);
+			return;
+		}
+	}
+
+	HAL_SPI_Transmit(rfm69->spi, (uint8_t *)data, data_size, HAL_MAX_DELAY);
+}
+
+/**
+ * @brief Receive raw bytes from the SPI bus, the chip select must already be active.
+ * DMA is used if selected in the RFM69 structure and the transfer is at least RFM69_DMA_MIN_SIZE bytes.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param data Pointer to the buffer to store the received data.
+ * @param data_size Size of the data to read.
+ */
+static void SPI_Receive(RFM69_t *rfm69, uint8_t *data, uint16_t data_size)
+{
+	if(rfm69->spi_transport == RFM69_SPI_DMA && data_size >= RFM69_DMA_MIN_SIZE)
+	{
+		if(HAL_SPI_Receive_DMA(rfm69->spi, data, data_size) == HAL_OK)
+		{
+			SPI_WaitForDMA(rfm69);
+			return;
+		}
+	}
+
+	HAL_SPI_Receive(rfm69->spi, data, data_size, HAL_MAX_DELAY);
+}
+
+/**
  * @brief Send data to the RFM69 module using SPI.
  * 
  * @param rfm69 Pointer to the RFM69 structure.
@@ -277,14 +1333,14 @@ static inline void SPI_ChipUnselect(RFM69_t *rfm69)
  * @param data Pointer to the data to send.
  * @param data_size Size of the data to send.
  */
-static void SPI_SendData(RFM69_t *rfm69, uint8_t addr, uint8_t *data, uint16_t data_size)
+static void SPI_SendData(RFM69_t *rfm69, uint8_t addr, const uint8_t *data, uint16_t data_size)
 {
 	// REGISTER
-	HAL_SPI_Transmit(rfm69->spi, &addr, 1, HAL_MAX_DELAY);
+	SPI_Transmit(rfm69, &addr, 1);
 
 	// DATA
 	if(data_size != 0)
-		HAL_SPI_Transmit(rfm69->spi, data, data_size, HAL_MAX_DELAY);
+		SPI_Transmit(rfm69, data, data_size);
 }
 
 /**
@@ -298,11 +1354,11 @@ static void SPI_SendData(RFM69_t *rfm69, uint8_t addr, uint8_t *data, uint16_t d
 static void SPI_ReadData(RFM69_t *rfm69, uint8_t addr, uint8_t *data, uint16_t data_size)
 {
 	// REGISTER
-	HAL_SPI_Transmit(rfm69->spi, &addr, 1, HAL_MAX_DELAY);
+	SPI_Transmit(rfm69, &addr, 1);
 
 	// DATA
 	if(data_size != 0)
-		HAL_SPI_Receive(rfm69->spi, data, data_size, HAL_MAX_DELAY);
+		SPI_Receive(rfm69, data, data_size);
 }
 
 /**
@@ -314,10 +1370,42 @@ static void SPI_ReadData(RFM69_t *rfm69, uint8_t addr, uint8_t *data, uint16_t d
  */
 static void WriteRegister(RFM69_t *rfm69, uint8_t reg, uint8_t byte)
 {
-	uint8_t reg_array[2] = { reg | 0x80, byte }; // 0x80 to set the write flag
+	if(ShadowMatches(rfm69, reg, byte))
+		return;
+
+	WriteBurst(rfm69, reg, &byte, 1);
+}
+
+/**
+ * @brief Write consecutive registers of the RFM69 module in a single SPI transaction.
+ * The module auto-increments the register address after each byte.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param reg First register address to write to.
+ * @param data Pointer to the bytes to write.
+ * @param data_size Number of registers to write.
+ */
+static void WriteBurst(RFM69_t *rfm69, uint8_t reg, const uint8_t *data, uint16_t data_size)
+{
+	SPI_ChipSelect(rfm69);
+	SPI_SendData(rfm69, reg | 0x80, data, data_size); // 0x80 to set the write flag
+	SPI_ChipUnselect(rfm69);
+
+	ShadowUpdate(rfm69, reg, data, data_size);
+}
 
+/**
+ * @brief Read consecutive registers of the RFM69 module in a single SPI transaction.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param reg First register address to read from.
+ * @param data Pointer to the buffer to store the register values.
+ * @param data_size Number of registers to read.
+ */
+static void ReadBurst(RFM69_t *rfm69, uint8_t reg, uint8_t *data, uint16_t data_size)
+{
 	SPI_ChipSelect(rfm69);
-	SPI_SendData(rfm69, reg_array[0], &reg_array[1], 1);
+	SPI_ReadData(rfm69, reg, data, data_size);
 	SPI_ChipUnselect(rfm69);
 }
 
@@ -332,48 +1420,665 @@ static uint8_t ReadRegister(RFM69_t *rfm69, uint8_t reg)
 {
 	uint8_t reg_value = 0;
 
-	SPI_ChipSelect(rfm69);
-	SPI_ReadData(rfm69, reg, &reg_value, 1);
-	SPI_ChipUnselect(rfm69);
+	ReadBurst(rfm69, reg, &reg_value, 1);
 
 	return reg_value;
 }
 
 /**
- * @brief Read the current mode of the RFM69 module.
+ * @brief Check if a register is kept in the shadow.
+ * Status, trigger and read-only registers (RegOsc1, RegVersion, AFC/FEI/RSSI, IRQ flags) always go to the module.
  * 
- * @param rfm69 Pointer to the RFM69 structure.
- * @return Current mode of the RFM69 module.
+ * @param reg Register address.
+ * @return 1 if the register is shadowed, 0 otherwise.
  */
-static uint8_t ReadMode(RFM69_t *rfm69)
+static inline uint8_t IsShadowed(uint8_t reg)
 {
-	return (ReadRegister(rfm69, 0x01) >> 2) & 0x07;
+	if(reg < RFM69_SHADOW_FIRST || reg > RFM69_SHADOW_LAST)
+		return 0;
+
+	return !(reg == 0x0A || reg == 0x10 || (reg >= 0x1E && reg <= 0x24) || reg == 0x27 || reg == 0x28);
 }
 
 /**
- * @brief Wait until the RFM69 module has changed to the desired mode.
+ * @brief Get the bits of a shadowed register that read back the value written.
+ * Read-only bits updated by the module and trigger bits that always read 0 are left out of the shadow
+ * and of every comparison with it.
+ * 
+ * @param reg Register address.
+ * @return Mask of the configuration bits.
+ */
+static inline uint8_t ReadBackMask(uint8_t reg)
+{
+	switch(reg)
+	{
+	case 0x18: // RegLna: LnaCurrentGain (bits 5-3) set by the AGC
+		return 0x87;
+	case 0x3D: // RegPacketConfig2: RestartRx trigger
+		return 0xFB;
+	default:
+		return 0xFF;
+	}
+}
+
+/**
+ * @brief Check if the shadow holds the current value of a register.
  * 
  * @param rfm69 Pointer to the RFM69 structure.
+ * @param reg Register address.
+ * @return 1 if the shadow value is valid, 0 otherwise.
  */
-static void WaitForModeReady(RFM69_t *rfm69)
+static inline uint8_t ShadowIsValid(RFM69_t *rfm69, uint8_t reg)
 {
-	uint32_t time_entry = HAL_GetTick();
+	uint8_t index = reg - RFM69_SHADOW_FIRST;
 
-	// Wait until ModeReady bit is set
-	while((ReadRegister(rfm69, 0x27) & 0x80) == 0 && (HAL_GetTick() - time_entry) < RFM69_TIMEOUT_MS)
-		;
+	return IsShadowed(reg) && (rfm69->_shadow_valid[index / 8] & (1 << (index % 8)));
 }
 
 /**
- * @brief Wait until the RFM69 module has sent a packet over the air.
+ * @brief Check if a register already holds a value according to the shadow.
  * 
  * @param rfm69 Pointer to the RFM69 structure.
+ * @param reg Register address.
+ * @param byte Value to compare.
+ * @return 1 if the shadow is valid and equal to the value, 0 otherwise.
  */
-static void WaitForPacketSent(RFM69_t *rfm69)
+static inline uint8_t ShadowMatches(RFM69_t *rfm69, uint8_t reg, uint8_t byte)
 {
-	uint32_t time_entry = HAL_GetTick();
+	return ShadowIsValid(rfm69, reg) && rfm69->_shadow[reg - RFM69_SHADOW_FIRST] == (byte & ReadBackMask(reg));
+}
 
-	// Wait until PacketSent bit is set
-	while((ReadRegister(rfm69, 0x28) & 0x08) == 0 && (HAL_GetTick() - time_entry) < RFM69_TIMEOUT_MS)
-		;
+/**
+ * @brief Store values written to (or read from) consecutive registers in the shadow.
+ * Registers that are not shadowed are ignored, bits outside ReadBackMask() are cleared.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param reg First register address.
+ * @param data Pointer to the register values.
+ * @param data_size Number of registers.
+ */
+static void ShadowUpdate(RFM69_t *rfm69, uint8_t reg, const uint8_t *data, uint16_t data_size)
+{
+	for(uint16_t i = 0; i < data_size; i++, reg++)
+	{
+		if(!IsShadowed(reg))
+			continue;
+
+		uint8_t index = reg - RFM69_SHADOW_FIRST;
+
+		rfm69->_shadow[index] = data[i] & ReadBackMask(reg);
+		rfm69->_shadow_valid[index / 8] |= 1 << (index % 8);
+	}
+}
+
+/**
+ * @brief Read a register from the shadow, or from the module if the shadow is not valid.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param reg Register address to read from.
+ * @return Value of the register.
+ */
+static uint8_t ReadRegisterCached(RFM69_t *rfm69, uint8_t reg)
+{
+	uint8_t reg_value;
+
+	if(ShadowIsValid(rfm69, reg))
+		return rfm69->_shadow[reg - RFM69_SHADOW_FIRST];
+
+	reg_value = ReadRegister(rfm69, reg);
+	ShadowUpdate(rfm69, reg, &reg_value, 1);
+
+	return reg_value & ReadBackMask(reg);
+}
+
+/**
+ * @brief Read the current mode of the RFM69 module.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return Current mode of the RFM69 module.
+ */
+static uint8_t ReadMode(RFM69_t *rfm69)
+{
+	return (ReadRegisterCached(rfm69, 0x01) >> 2) & 0x07;
+}
+
+/**
+ * @brief Change the mode of the RFM69 module, also while an operation is in progress.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param mode Mode to set (see rfm69.h for available modes).
+ */
+static void WriteMode(RFM69_t *rfm69, uint8_t mode)
+{
+	if((mode == ReadMode(rfm69)) || (mode > RFM69_MODE_RX))
+		return;
+
+	WriteRegister(rfm69, 0x01, mode << 2);
+}
+
+/**
+ * @brief Wait until the RFM69 module has changed to the desired mode.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ */
+static int WaitForModeReady(RFM69_t *rfm69)
+{
+	uint32_t time_entry = HAL_GetTick();
+	uint32_t start_us = GetTimeUs();
+
+	// Wait until ModeReady bit is set
+	while(!ModeIsReady(rfm69))
+	{
+		if((HAL_GetTick() - time_entry) >= RFM69_TIMEOUT_MS)
+			return CountOperation(rfm69, RFM69_COUNTER_MODE, start_us, RFM69_TIMEOUT);
+	}
+
+	return CountOperation(rfm69, RFM69_COUNTER_MODE, start_us, RFM69_OK);
+}
+
+/**
+ * @brief Check if the RFM69 module has completed its last mode change.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return 1 if the ModeReady flag is set, 0 otherwise.
+ */
+static uint8_t ModeIsReady(RFM69_t *rfm69)
+{
+	return (ReadRegister(rfm69, 0x27) & 0x80) != 0;
+}
+
+/**
+ * @brief Check if the RFM69 module has sent the packet.
+ * With tx_irq_en the DIO0 pin (PacketSent) is read instead of the IRQ flags.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return 1 if the packet was sent, 0 otherwise.
+ */
+static uint8_t PacketIsSent(RFM69_t *rfm69)
+{
+	if(rfm69->tx_irq_en)
+		return HAL_GPIO_ReadPin(rfm69->dio0.port, rfm69->dio0.pin) == GPIO_PIN_SET;
+
+	return (ReadRegister(rfm69, 0x28) & 0x08) != 0;
+}
+
+/**
+ * @brief Start an asynchronous operation.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param operation Operation started.
+ * @param state First state of the operation.
+ */
+static void StartOperation(RFM69_t *rfm69, uint8_t operation, uint8_t state)
+{
+	rfm69->_op = operation;
+	rfm69->_op_start_us = GetTimeUs();
+	SetOperationState(rfm69, state);
+}
+
+/**
+ * @brief Move the operation in progress to its next state, the state timeout starts again.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param state New state.
+ */
+static void SetOperationState(RFM69_t *rfm69, uint8_t state)
+{
+	rfm69->_op_state = state;
+	rfm69->_op_tick = HAL_GetTick();
+}
+
+/**
+ * @brief Complete the operation in progress and call the completion callback.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param status Result of the operation.
+ * @return Result of the operation.
+ */
+static int FinishOperation(RFM69_t *rfm69, int status)
+{
+	uint8_t operation = rfm69->_op;
+
+	rfm69->_op = RFM69_OP_NONE;
+	rfm69->_op_state = RFM69_STATE_IDLE;
+	rfm69->_op_status = CountOperation(rfm69, rfm69_op_counters[operation], rfm69->_op_start_us, status);
+
+	if(rfm69->op_callback != NULL)
+		rfm69->op_callback(rfm69, operation, status);
+
+	return status;
+}
+
+/**
+ * @brief Run the operation in progress until it completes (blocking functions).
+ * While the packet is on air with tx_irq_en, the MCU sleeps until the DIO0 interrupt.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return Result of the operation.
+ */
+static int WaitForOperation(RFM69_t *rfm69)
+{
+	int status;
+
+	while((status = RFM69_Poll(rfm69)) == RFM69_BUSY)
+	{
+		if(rfm69->tx_irq_en && rfm69->_op_state == RFM69_STATE_SEND_TX && rfm69->_op_bytes == rfm69->_op_size)
+		{
+			// Sleep until DIO0 (PacketSent) rises, the EXTI interrupt (or the SysTick) wakes the core up
+			__disable_irq();
+
+			if(HAL_GPIO_ReadPin(rfm69->dio0.port, rfm69->dio0.pin) == GPIO_PIN_RESET)
+				__WFI();
+
+			__enable_irq();
+		}
+	}
+
+	return status;
+}
+
+/**
+ * @brief Get a microsecond timestamp from the HAL tick and the SysTick counter.
+ * Wraps around after about 71 minutes, only differences are meaningful.
+ * 
+ * @return Timestamp in microseconds.
+ */
+static uint32_t GetTimeUs(void)
+{
+	uint32_t tick;
+	uint32_t val;
+
+	// Suspended HAL tick (MCU_Sleep()) or SysTick not reloaded every 1 ms at the current clock
+	// (wake-up from STOP before the clocks are restored): no time base
+	if((SysTick->CTRL & SysTick_CTRL_TICKINT_Msk) == 0 || SysTick->LOAD + 1 != SystemCoreClock / 1000)
+		return RFM69_TIME_INVALID;
+
+	// Read again if the SysTick reloaded (HAL tick incremented) in between
+	do
+	{
+		tick = HAL_GetTick();
+		val = SysTick->VAL;
+	} while(tick != HAL_GetTick());
+
+	// SysTick counts down from LOAD to 0 every tick (1 ms)
+	return tick * 1000 + (SysTick->LOAD - val) * 1000 / (SysTick->LOAD + 1);
+}
+
+/**
+ * @brief Count a completed operation in its timing counter.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param counter Timing counter (see rfm69.h for available counters).
+ * @param start_us Start of the operation (GetTimeUs()).
+ * @param status Result of the operation.
+ * @return Result of the operation.
+ */
+static int CountOperation(RFM69_t *rfm69, uint8_t counter, uint32_t start_us, int status)
+{
+	RFM69_Counter_t *c = &rfm69->counters[counter];
+	uint32_t end_us = GetTimeUs();
+	uint32_t duration_us = end_us - start_us;
+
+	c->calls++;
+
+	// Started or ended without a time base: counted, but kept out of the durations
+	if(start_us == RFM69_TIME_INVALID || end_us == RFM69_TIME_INVALID)
+		c->untimed++;
+	else
+	{
+		if(c->calls - c->untimed == 1 || duration_us < c->min_us)
+			c->min_us = duration_us;
+		if(duration_us > c->max_us)
+			c->max_us = duration_us;
+
+		c->total_us += duration_us;
+	}
+
+	if(status == RFM69_TIMEOUT)
+		c->timeouts++;
+
+	return status;
+}
+
+/**
+ * @brief Check for a received packet and read it (RFM69_STATE_RECEIVE).
+ * The RSSI, AFC and IRQ flags are read in one burst while the module is still in RX.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return 1 if a packet was handled (read or dropped on CRC error), 0 if nothing was received yet.
+ */
+static uint8_t ReceivePacket(RFM69_t *rfm69)
+{
+	uint8_t status[10]; // RegAfc, RegFei, RegRssiConfig, RegRssiValue, RegDioMapping1/2, RegIrqFlags1/2
+	uint8_t irq_flags;
+	int16_t packet_rssi;
+	int16_t packet_afc;
+
+	// RSSI and AFC still hold the values measured for the packet while the module has not left RX
+	ReadBurst(rfm69, 0x1F, status, sizeof(status));
+	irq_flags = status[9];
+	packet_rssi = -(int16_t)status[5] / 2;
+	packet_afc = (int16_t)((status[0] << 8) | status[1]);
+
+	// If PayloadReady flag is set (or FIFO not empty in listen mode, DI0 IRQ already signaled PayloadReady)
+	if(!(irq_flags & 0x04 || (rfm69->_listen_mode_activated && (irq_flags & 0x40))))
+		return 0;
+
+	WriteMode(rfm69, RFM69_MODE_STANDBY);
+
+	// CrcAutoClearOff: PayloadReady is also raised on CRC errors, CrcOk tells them apart
+	if((irq_flags & 0x04) && !(irq_flags & 0x02) && (ReadRegisterCached(rfm69, 0x37) & 0x08))
+	{
+		WriteRegister(rfm69, 0x28, 0x10); // Clear FIFO
+		rfm69->stats.crc_failures++;
+	}
+	else
+		rfm69->_op_bytes = ReadPayload(rfm69, rfm69->_op_data, rfm69->_op_size);
+
+	if(rfm69->_op_bytes > 0)
+	{
+		rfm69->stats.packets++;
+		StatsAddRSSI(rfm69, packet_rssi);
+		rfm69->_op_rssi = packet_rssi;
+
+		// The AFC correction is relative to the carrier currently set, not to the nominal one
+		if(rfm69->_afc_en)
+			rfm69->_freq_offset_hz = rfm69->_freq_correction_hz + (int32_t)(((int64_t)packet_afc * RFM69_FXOSC) >> RFM69_FSTEP_SHIFT);
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Wait until the RFM69 module has sent a packet over the air.
+ * With tx_irq_en the MCU sleeps until DIO0 rises, otherwise the PacketSent flag is polled.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @return 1 if the packet was sent, 0 on timeout.
+ */
+static uint8_t WaitForPacketSent(RFM69_t *rfm69)
+{
+	uint32_t time_entry = HAL_GetTick();
+
+	if(rfm69->tx_irq_en)
+	{
+		// Sleep until DIO0 (PacketSent) rises, the EXTI interrupt (or the SysTick) wakes the core up
+		__disable_irq();
+
+		while(HAL_GPIO_ReadPin(rfm69->dio0.port, rfm69->dio0.pin) == GPIO_PIN_RESET && (HAL_GetTick() - time_entry) < RFM69_TIMEOUT_MS)
+		{
+			__WFI();
+			__enable_irq();
+			__disable_irq();
+		}
+
+		__enable_irq();
+
+		return HAL_GPIO_ReadPin(rfm69->dio0.port, rfm69->dio0.pin) == GPIO_PIN_SET;
+	}
+
+	// Wait until PacketSent bit is set
+	while((ReadRegister(rfm69, 0x28) & 0x08) == 0)
+	{
+		if((HAL_GetTick() - time_entry) >= RFM69_TIMEOUT_MS)
+			return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Read a received payload from the RFM69 FIFO.
+ * When the packet length is known (fixed length or variable length packet format), the payload
+ * is read in a single burst transaction. In variable length mode the length byte is not copied to the buffer.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param buffer Pointer to the buffer to store the payload.
+ * @param buffer_size Size of the buffer.
+ * @return Number of bytes copied to the buffer.
+ */
+static size_t ReadPayload(RFM69_t *rfm69, uint8_t *buffer, size_t buffer_size)
+{
+	uint8_t packet_config = ReadRegisterCached(rfm69, 0x37);
+	uint8_t payload_length = ReadRegisterCached(rfm69, 0x38);
+	size_t bytes_read = 0;
+
+	// Unlimited length packet format: read until FIFO is empty or buffer size is reached
+	if(!(packet_config & 0x80) && payload_length == 0)
+	{
+		while((ReadRegister(rfm69, 0x28) & 0x40) && (bytes_read < buffer_size))
+		{
+			buffer[bytes_read] = ReadRegister(rfm69, 0x00);
+			bytes_read++;
+		}
+
+		return bytes_read;
+	}
+
+	SPI_ChipSelect(rfm69);
+
+	if(packet_config & 0x80) // Variable length: the first FIFO byte is the payload length
+	{
+		SPI_ReadData(rfm69, 0x00, &payload_length, 1);
+		bytes_read = payload_length < buffer_size ? payload_length : buffer_size;
+
+		if(bytes_read != 0)
+			SPI_Receive(rfm69, buffer, bytes_read);
+	}
+	else
+	{
+		bytes_read = payload_length < buffer_size ? payload_length : buffer_size;
+		SPI_ReadData(rfm69, 0x00, buffer, bytes_read);
+	}
+
+	SPI_ChipUnselect(rfm69);
+
+	// Payload larger than the buffer: drop the remaining bytes
+	if(bytes_read < payload_length)
+		WriteRegister(rfm69, 0x28, 0x10);
+
+	return bytes_read;
+}
+
+/**
+ * @brief Write the beginning of a message to the RFM69 FIFO in a single SPI transaction.
+ * In variable length packet format, the length byte (length of the whole message) is added before the message.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param message Pointer to the message to write.
+ * @param message_size Size of the whole message.
+ * @param chunk_size Number of message bytes to write now (the rest is streamed with WriteFIFOChunk()).
+ */
+static void WriteFIFO(RFM69_t *rfm69, uint8_t *message, size_t message_size, size_t chunk_size)
+{
+	uint8_t length = message_size;
+
+	SPI_ChipSelect(rfm69);
+
+	if(ReadRegisterCached(rfm69, 0x37) & 0x80) // Variable length: length byte first
+	{
+		SPI_SendData(rfm69, 0x00 | 0x80, &length, 1);
+		SPI_Transmit(rfm69, message, chunk_size);
+	}
+	else
+		SPI_SendData(rfm69, 0x00 | 0x80, message, chunk_size);
+
+	SPI_ChipUnselect(rfm69);
+}
+
+/**
+ * @brief Append bytes to the RFM69 FIFO in a single SPI transaction.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param data Pointer to the bytes to write.
+ * @param data_size Number of bytes to write.
+ */
+static void WriteFIFOChunk(RFM69_t *rfm69, uint8_t *data, size_t data_size)
+{
+	SPI_ChipSelect(rfm69);
+	SPI_SendData(rfm69, 0x00 | 0x80, data, data_size);
+	SPI_ChipUnselect(rfm69);
+}
+
+/**
+ * @brief Check if a payload can be sent with the current configuration.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param payload_size Size of the payload.
+ * @return 1 if the payload can be sent, 0 if it is too long.
+ */
+static uint8_t PayloadSizeIsValid(RFM69_t *rfm69, size_t payload_size)
+{
+	if(ReadRegisterCached(rfm69, 0x3D) & 0x01) // AesOn: no FIFO streaming
+		return payload_size <= RFM69_AES_MAX_PAYLOAD_SIZE;
+
+	return payload_size <= RFM69_MAX_PAYLOAD_SIZE;
+}
+
+/**
+ * @brief Transmit a packet and wait until it is sent.
+ * The FIFO is filled, TX is started and, for packets longer than the FIFO,
+ * the FIFO is refilled each time its level drops to FifoThreshold.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param message Pointer to the message to send.
+ * @param message_size Size of the message.
+ * @return 1 if the packet was sent, 0 on timeout.
+ */
+static uint8_t TransmitPacket(RFM69_t *rfm69, uint8_t *message, size_t message_size)
+{
+	size_t bytes_written = message_size < RFM69_FIFO_SIZE - 1 ? message_size : RFM69_FIFO_SIZE - 1;
+	uint32_t time_entry;
+
+	WriteFIFO(rfm69, message, message_size, bytes_written);
+
+	WriteMode(rfm69, RFM69_MODE_TX);
+
+	time_entry = HAL_GetTick();
+
+	while(bytes_written < message_size)
+	{
+		if(HAL_GetTick() - time_entry >= RFM69_TIMEOUT_MS)
+			return 0;
+
+		RefillFIFO(rfm69, message, message_size, &bytes_written, ReadRegister(rfm69, 0x28));
+	}
+
+	return WaitForPacketSent(rfm69);
+}
+
+/**
+ * @brief Write the next chunk of a long message to the FIFO if there is room for it.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param message Pointer to the whole message.
+ * @param message_size Size of the whole message.
+ * @param bytes_written Pointer to the number of bytes already written, updated.
+ * @param irq_flags Current RegIrqFlags2 value.
+ */
+static void RefillFIFO(RFM69_t *rfm69, uint8_t *message, size_t message_size, size_t *bytes_written, uint8_t irq_flags)
+{
+	// FifoLevel: still more than FifoThreshold bytes to send
+	if(irq_flags & 0x20)
+		return;
+
+	// At most FifoThreshold bytes left in the FIFO: room for the next chunk
+	size_t chunk_size = message_size - *bytes_written;
+	if(chunk_size > RFM69_FIFO_SIZE - RFM69_FIFO_THRESHOLD - 1)
+		chunk_size = RFM69_FIFO_SIZE - RFM69_FIFO_THRESHOLD - 1;
+
+	WriteFIFOChunk(rfm69, message + *bytes_written, chunk_size);
+	*bytes_written += chunk_size;
+}
+
+/**
+ * @brief Add a packet RSSI sample to the link quality statistics.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param rssi RSSI in dBm.
+ */
+static void StatsAddRSSI(RFM69_t *rfm69, int16_t rssi)
+{
+	RFM69_Stats_t *stats = &rfm69->stats;
+
+	if(stats->rssi_count == 0 || rssi < stats->rssi_min)
+		stats->rssi_min = rssi;
+
+	if(stats->rssi_count == 0 || rssi > stats->rssi_max)
+		stats->rssi_max = rssi;
+
+	stats->rssi_sum += rssi;
+	stats->rssi_count++;
+}
+
+/**
+ * @brief Find the listen mode resolution and coefficient closest to a duration.
+ * 
+ * @param duration_us Duration in microseconds.
+ * @param round_up 1 to never go below the duration, 0 to take the closest value.
+ * @param resol Pointer to store the resolution (1 to 3).
+ * @param coef Pointer to store the coefficient (1 to 255).
+ * @return 0 on success, -1 if the duration can't be encoded.
+ */
+static int EncodeListenDuration(uint32_t duration_us, uint8_t round_up, uint8_t *resol, uint8_t *coef)
+{
+	uint32_t best_error = UINT32_MAX;
+
+	for(uint8_t r = 1; r <= 3; r++)
+	{
+		uint32_t resol_us = rfm69_listen_resol_us[r];
+		uint32_t c = round_up ? (duration_us + resol_us - 1) / resol_us : (duration_us + resol_us / 2) / resol_us;
+
+		if(c == 0)
+			c = 1;
+
+		if(c > 255)
+			continue;
+
+		uint32_t achieved_us = c * resol_us;
+		uint32_t error = achieved_us > duration_us ? achieved_us - duration_us : duration_us - achieved_us;
+
+		// Finest resolution first: only a strictly better encoding replaces it
+		if(error < best_error)
+		{
+			best_error = error;
+			*resol = r;
+			*coef = c;
+		}
+	}
+
+	return best_error == UINT32_MAX ? -1 : 0;
+}
+
+/**
+ * @brief Convert a duration to a RegRxTimeout value (units of 16 bit periods) at the current bitrate.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param duration_us Duration in microseconds.
+ * @return Timeout register value, rounded up and limited to 1 to 255 (0 would disable the timeout).
+ */
+static uint8_t RxTimeoutFromUs(RFM69_t *rfm69, uint32_t duration_us)
+{
+	uint32_t bitrate_reg = (ReadRegisterCached(rfm69, 0x03) << 8) | ReadRegisterCached(rfm69, 0x04);
+	// 16 bit periods = 16 * bitrate_reg / FXOSC = bitrate_reg / 2 us
+	uint32_t timeout = (uint32_t)(((uint64_t)duration_us * 2 + bitrate_reg - 1) / bitrate_reg);
+
+	if(timeout == 0)
+		return 1;
+
+	return timeout > 255 ? 255 : timeout;
+}
+
+/**
+ * @brief Convert a RegRxTimeout value to a duration at the current bitrate.
+ * 
+ * @param rfm69 Pointer to the RFM69 structure.
+ * @param timeout Timeout register value (units of 16 bit periods).
+ * @return Duration in microseconds.
+ */
+static uint32_t RxTimeoutToUs(RFM69_t *rfm69, uint8_t timeout)
+{
+	uint32_t bitrate_reg = (ReadRegisterCached(rfm69, 0x03) << 8) | ReadRegisterCached(rfm69, 0x04);
+
+	return (uint32_t)(((uint64_t)timeout * 16 * bitrate_reg * 1000000) / RFM69_FXOSC);
 }
@@ -0,0 +1,92 @@
+/**
+ * @file        txpower.c
+ * @brief       Adaptive RFM69 output power control
+ * @author      Esteban CADIC
+ * @version     1.0
+ * @date        2025
+ * @copyright   MIT License
+ *
+ */
+
+#include "txpower.h"
+#include "eeprom.h"
+
+
+/*------------------------------------------------------------------------------
+	PROTOTYPES
+------------------------------------------------------------------------------*/
+
+static int SetPower(TXPOWER_t *ctrl, int16_t dbm);
+
+
+/*------------------------------------------------------------------------------
+	FONCTIONS
+------------------------------------------------------------------------------*/
+
+int TXPOWER_Init(TXPOWER_t *ctrl, RFM69_t *rfm69, int8_t min_dbm, int8_t max_dbm)
+{
+	uint8_t saved[EEPROM_TX_POWER_SIZE];
+
+	ctrl->rfm69 = rfm69;
+	ctrl->min_dbm = min_dbm;
+	ctrl->max_dbm = max_dbm;
+	ctrl->acks = 0;
+	ctrl->failures = 0;
+
+	// The power is stored with its complement, an erased EEPROM (0x00 0x00) is not a valid value
+	if(EEPROM_Read(EEPROM_TX_POWER_ADDR, saved, sizeof(saved)) == 0 && (saved[0] ^ saved[1]) == 0xFF)
+		ctrl->dbm = (int8_t)saved[0];
+	else
+		ctrl->dbm = max_dbm;
+
+	return SetPower(ctrl, ctrl->dbm);
+}
+
+void TXPOWER_Acknowledged(TXPOWER_t *ctrl, int8_t rssi)
+{
+	ctrl->acks++;
+
+	if(rssi < TXPOWER_TARGET_RSSI_DBM)
+		SetPower(ctrl, ctrl->dbm + (TXPOWER_TARGET_RSSI_DBM - rssi)); // Margin lost: compensate at once
+	else if(rssi >= TXPOWER_TARGET_RSSI_DBM + TXPOWER_HYSTERESIS_DB)
+		SetPower(ctrl, ctrl->dbm - TXPOWER_STEP_DOWN_DB);
+}
+
+void TXPOWER_Failed(TXPOWER_t *ctrl)
+{
+	ctrl->failures++;
+
+	SetPower(ctrl, ctrl->dbm + TXPOWER_STEP_UP_DB);
+}
+
+
+/**
+ * @brief Apply an output power, limited to the allowed range, and save it in the data EEPROM.
+ * The EEPROM is only programmed when the value changes.
+ * 
+ * @param ctrl Pointer to the controller.
+ * @param dbm Output power in dBm.
+ * @return 0 on success, RFM69_SetPowerDBm() error otherwise.
+ */
+static int SetPower(TXPOWER_t *ctrl, int16_t dbm)
+{
+	uint8_t saved[EEPROM_TX_POWER_SIZE];
+	int status;
+
+	if(dbm < ctrl->min_dbm)
+		dbm = ctrl->min_dbm;
+	else if(dbm > ctrl->max_dbm)
+		dbm = ctrl->max_dbm;
+
+	status = RFM69_SetPowerDBm(ctrl->rfm69, dbm);
+	if(status)
+		return status;
+
+	ctrl->dbm = dbm;
+
+	saved[0] = (uint8_t)ctrl->dbm;
+	saved[1] = ~saved[0];
+	EEPROM_Write(EEPROM_TX_POWER_ADDR, saved, sizeof(saved));
+
+	return 0;
+}
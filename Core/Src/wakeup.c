@@ -0,0 +1,118 @@
+/**
+ * @file        wakeup.c
+ * @brief       Periodic wake-up timer (RTC wake-up unit clocked by the LSI)
+ * @author      Esteban CADIC
+ * @version     1.0
+ * @date        2025
+ * @copyright   MIT License
+ *
+ */
+
+#include "wakeup.h"
+
+
+/*------------------------------------------------------------------------------
+	CONSTANTS
+------------------------------------------------------------------------------*/
+
+/** RTC prescalers: LSI / (PREDIV_A + 1) / (PREDIV_S + 1) = 1 Hz (ck_spre) */
+#define WAKEUP_PREDIV_A		127
+#define WAKEUP_PREDIV_S		(LSI_VALUE / (WAKEUP_PREDIV_A + 1) - 1)
+
+/** WUCKSEL = 10x: wake-up counter clocked by ck_spre (1 Hz) */
+#define WAKEUP_CLOCK_SPRE	RTC_CR_WUCKSEL_2
+
+#define WAKEUP_TIMEOUT_MS	100
+
+
+/*------------------------------------------------------------------------------
+	PROTOTYPES
+------------------------------------------------------------------------------*/
+
+static int WaitForFlag(uint32_t flag);
+
+
+/*------------------------------------------------------------------------------
+	FONCTIONS
+------------------------------------------------------------------------------*/
+
+int WAKEUP_Init(uint32_t period_s)
+{
+	if(period_s == 0 || period_s > WAKEUP_MAX_PERIOD_S)
+		return -1;
+
+	// LSI on, then RTC clocked by the LSI (backup domain write access needed)
+	RCC->CSR |= RCC_CSR_LSION;
+	while((RCC->CSR & RCC_CSR_LSIRDY) == 0)
+		;
+
+	__HAL_RCC_PWR_CLK_ENABLE();
+	PWR->CR |= PWR_CR_DBP;
+	RCC->CSR = (RCC->CSR & ~RCC_CSR_RTCSEL) | RCC_CSR_RTCSEL_LSI | RCC_CSR_RTCEN;
+
+	// Remove the RTC write protection
+	RTC->WPR = 0xCA;
+	RTC->WPR = 0x53;
+
+	// Prescalers (initialization mode)
+	RTC->ISR |= RTC_ISR_INIT;
+	if(WaitForFlag(RTC_ISR_INITF))
+		return -1;
+
+	RTC->PRER = (WAKEUP_PREDIV_A << RTC_PRER_PREDIV_A_Pos) | (WAKEUP_PREDIV_S << RTC_PRER_PREDIV_S_Pos);
+	RTC->ISR &= ~RTC_ISR_INIT;
+
+	// Wake-up timer (stopped while its configuration is written)
+	RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+	if(WaitForFlag(RTC_ISR_WUTWF))
+		return -1;
+
+	RTC->WUTR = period_s - 1;
+	RTC->CR = (RTC->CR & ~RTC_CR_WUCKSEL) | WAKEUP_CLOCK_SPRE;
+	RTC->ISR &= ~RTC_ISR_WUTF;
+	RTC->CR |= RTC_CR_WUTIE | RTC_CR_WUTE;
+
+	RTC->WPR = 0xFF;
+
+	// EXTI line 20 (RTC wake-up), rising edge: wakes the MCU up from STOP mode
+	EXTI->IMR |= EXTI_IMR_IM20;
+	EXTI->RTSR |= EXTI_RTSR_TR20;
+	EXTI->PR = EXTI_PR_PIF20;
+
+	HAL_NVIC_SetPriority(RTC_IRQn, 0, 0);
+	HAL_NVIC_EnableIRQ(RTC_IRQn);
+
+	return 0;
+}
+
+void WAKEUP_IRQHandler(void)
+{
+	if(RTC->ISR & RTC_ISR_WUTF)
+	{
+		// WUTF is cleared by writing 0, the other flags are left unchanged (INIT kept)
+		RTC->ISR = (~(RTC_ISR_WUTF | RTC_ISR_INIT) & 0x0001FFFF) | (RTC->ISR & RTC_ISR_INIT);
+		g_flag_wakeup = 1;
+	}
+
+	EXTI->PR = EXTI_PR_PIF20;
+}
+
+
+/**
+ * @brief Wait until an RTC status flag is set.
+ *
+ * @param flag RTC_ISR flag.
+ * @return 0 if the flag is set, -1 on timeout.
+ */
+static int WaitForFlag(uint32_t flag)
+{
+	uint32_t time_entry = HAL_GetTick();
+
+	while((RTC->ISR & flag) == 0)
+	{
+		if(HAL_GetTick() - time_entry >= WAKEUP_TIMEOUT_MS)
+			return -1;
+	}
+
+	return 0;
+}
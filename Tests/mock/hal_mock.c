@@ -0,0 +1,188 @@
+/**
+ * @file        hal_mock.c
+ * @brief       Simulated SPI peripheral and RFM69 register file for the host tests
+ * @author      Esteban CADIC
+ * @version     1.0
+ * @date        2025
+ * @copyright   MIT License
+ *
+ */
+
+#include <string.h>
+
+#include "hal_mock.h"
+
+
+/*------------------------------------------------------------------------------
+	DECLARATIONS
+------------------------------------------------------------------------------*/
+
+MOCK_SPI_t mock_spi;
+SysTick_Type mock_systick;
+uint32_t SystemCoreClock = 32000000;
+
+static uint32_t tick;
+
+// Bus state: the first byte after the chip select is the address (bit 7: write)
+static uint8_t cs_active;
+static uint8_t expect_addr;
+static uint8_t addr;
+static uint8_t write;
+
+// DMA transfer in progress, completed by the interrupt that wakes __WFI() up
+static uint8_t *dma_data;
+static uint16_t dma_size;
+static uint8_t dma_rx;
+
+
+/*------------------------------------------------------------------------------
+	PROTOTYPES
+------------------------------------------------------------------------------*/
+
+static void Exchange(uint8_t *data, uint16_t size, uint8_t rx);
+
+
+/*------------------------------------------------------------------------------
+	FONCTIONS
+------------------------------------------------------------------------------*/
+
+void MOCK_Reset(void)
+{
+	memset(&mock_spi, 0, sizeof(mock_spi));
+	mock_systick.CTRL = SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk; // HAL tick running
+	mock_systick.LOAD = 32000 - 1;
+	mock_systick.VAL = 0;
+	SystemCoreClock = 32000000;
+	cs_active = 0;
+	dma_data = NULL;
+}
+
+uint32_t HAL_GetTick(void)
+{
+	// Time advances by 1 ms every few calls: polling loops end, consecutive reads usually match
+	return tick++ / 16;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	if(dma_data != NULL)
+		mock_spi.busy_access++;
+
+	cs_active = PinState == GPIO_PIN_RESET;
+	expect_addr = cs_active;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	return GPIO_PIN_SET;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	mock_spi.blocking_transfers++;
+	Exchange(pData, Size, 0);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	mock_spi.blocking_transfers++;
+	Exchange(pData, Size, 1);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	if(mock_spi.dma_errors_to_inject > 0)
+	{
+		mock_spi.dma_errors_to_inject--;
+		return HAL_ERROR;
+	}
+
+	mock_spi.dma_transfers++;
+	dma_data = pData;
+	dma_size = Size;
+	dma_rx = 0;
+	hspi->State = HAL_SPI_STATE_BUSY;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	HAL_StatusTypeDef status = HAL_SPI_Transmit_DMA(hspi, pData, Size);
+
+	dma_rx = 1;
+
+	return status;
+}
+
+HAL_SPI_StateTypeDef HAL_SPI_GetState(SPI_HandleTypeDef *hspi)
+{
+	if(dma_data != NULL && !mock_spi.irq_masked)
+		mock_spi.state_unmasked++;
+
+	return dma_data != NULL ? HAL_SPI_STATE_BUSY : HAL_SPI_STATE_READY;
+}
+
+void __disable_irq(void)
+{
+	mock_spi.irq_masked = 1;
+}
+
+void __enable_irq(void)
+{
+	mock_spi.irq_masked = 0;
+}
+
+void __WFI(void)
+{
+	mock_spi.wfi_calls++;
+
+	if(!mock_spi.irq_masked)
+		mock_spi.wfi_unmasked++;
+
+	// The DMA transfer complete interrupt is pending: wake up, the handler runs once unmasked
+	if(dma_data != NULL)
+	{
+		uint8_t *data = dma_data;
+
+		dma_data = NULL;
+		Exchange(data, dma_size, dma_rx);
+	}
+}
+
+
+/**
+ * @brief Clock bytes through the simulated RFM69 (auto-increment address, except on the FIFO).
+ *
+ * @param data Bytes sent, or buffer for the bytes received.
+ * @param size Number of bytes.
+ * @param rx 1 to receive, 0 to send.
+ */
+static void Exchange(uint8_t *data, uint16_t size, uint8_t rx)
+{
+	if(dma_data != NULL || !cs_active)
+		mock_spi.busy_access++;
+
+	for(uint16_t i = 0; i < size; i++)
+	{
+		if(expect_addr && !rx)
+		{
+			addr = data[i] & 0x7F;
+			write = (data[i] & 0x80) != 0;
+			expect_addr = 0;
+			continue;
+		}
+
+		if(rx)
+			data[i] = mock_spi.regs[addr];
+		else if(write)
+			mock_spi.regs[addr] = data[i];
+
+		if(addr != 0x00)
+			addr = (addr + 1) & 0x7F;
+	}
+}
@@ -0,0 +1,51 @@
+/**
+ * @file        hal_mock.h
+ * @brief       Simulated SPI peripheral and RFM69 register file for the host tests
+ * @author      Esteban CADIC
+ * @version     1.0
+ * @date        2025
+ * @copyright   MIT License
+ *
+ */
+
+#ifndef MOCK_HAL_MOCK_H_
+#define MOCK_HAL_MOCK_H_
+
+#include "stm32l0xx_hal.h"
+
+
+/*------------------------------------------------------------------------------
+	TYPE DEFINITIONS
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief State of the simulated SPI bus, inspected by the tests.
+ */
+typedef struct MOCK_SPI
+{
+	uint8_t regs[0x80]; /**< RFM69 register file behind the bus */
+
+	uint32_t blocking_transfers; /**< HAL_SPI_Transmit()/HAL_SPI_Receive() calls */
+	uint32_t dma_transfers; /**< DMA transfers started */
+	uint32_t dma_errors_to_inject; /**< Next DMA starts failing with HAL_ERROR */
+	uint32_t wfi_calls; /**< __WFI() calls */
+
+	uint32_t wfi_unmasked; /**< __WFI() called with interrupts enabled (DMA complete IRQ could be missed) */
+	uint32_t state_unmasked; /**< SPI state read with interrupts enabled during a DMA transfer */
+	uint32_t busy_access; /**< Bus used or chip unselected while a DMA transfer is in progress */
+	uint8_t irq_masked; /**< Interrupts currently masked */
+} MOCK_SPI_t;
+
+
+/*------------------------------------------------------------------------------
+	DECLARATIONS
+------------------------------------------------------------------------------*/
+
+extern MOCK_SPI_t mock_spi;
+
+/**
+ * @brief Reset the simulated bus, the register file and the counters.
+ */
+extern void MOCK_Reset(void);
+
+#endif /* MOCK_HAL_MOCK_H_ */
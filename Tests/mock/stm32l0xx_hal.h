@@ -0,0 +1,106 @@
+/**
+ * @file        stm32l0xx_hal.h
+ * @brief       Host mock of the STM32L0 HAL subset used by the RFM69 driver
+ * @author      Esteban CADIC
+ * @version     1.0
+ * @date        2025
+ * @copyright   MIT License
+ *
+ */
+
+#ifndef MOCK_STM32L0XX_HAL_H_
+#define MOCK_STM32L0XX_HAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/*------------------------------------------------------------------------------
+	CONSTANTS
+------------------------------------------------------------------------------*/
+
+#define HAL_MAX_DELAY	0xFFFFFFFFU
+
+#define GPIO_PIN_0	((uint16_t)0x0001)
+#define GPIO_PIN_1	((uint16_t)0x0002)
+#define GPIO_PIN_2	((uint16_t)0x0004)
+#define GPIO_PIN_4	((uint16_t)0x0010)
+#define GPIO_PIN_5	((uint16_t)0x0020)
+#define GPIO_PIN_6	((uint16_t)0x0040)
+#define GPIO_PIN_7	((uint16_t)0x0080)
+#define GPIO_PIN_9	((uint16_t)0x0200)
+#define GPIO_PIN_10	((uint16_t)0x0400)
+
+
+/*------------------------------------------------------------------------------
+	TYPE DEFINITIONS
+------------------------------------------------------------------------------*/
+
+typedef enum
+{
+	HAL_OK = 0x00,
+	HAL_ERROR = 0x01,
+	HAL_BUSY = 0x02,
+	HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+	GPIO_PIN_RESET = 0,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef enum
+{
+	HAL_SPI_STATE_RESET = 0x00,
+	HAL_SPI_STATE_READY = 0x01,
+	HAL_SPI_STATE_BUSY = 0x02
+} HAL_SPI_StateTypeDef;
+
+typedef struct
+{
+	uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef struct
+{
+	volatile HAL_SPI_StateTypeDef State;
+} SPI_HandleTypeDef;
+
+typedef struct
+{
+	volatile uint32_t CTRL;
+	volatile uint32_t LOAD;
+	volatile uint32_t VAL;
+	volatile uint32_t CALIB;
+} SysTick_Type;
+
+extern SysTick_Type mock_systick;
+extern uint32_t SystemCoreClock;
+
+#define SysTick	(&mock_systick)
+
+#define SysTick_CTRL_TICKINT_Msk	(1UL << 1)
+#define SysTick_CTRL_ENABLE_Msk		(1UL << 0)
+
+
+/*------------------------------------------------------------------------------
+	DECLARATIONS
+------------------------------------------------------------------------------*/
+
+uint32_t HAL_GetTick(void);
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+HAL_SPI_StateTypeDef HAL_SPI_GetState(SPI_HandleTypeDef *hspi);
+
+void __disable_irq(void);
+void __enable_irq(void);
+void __WFI(void);
+
+#endif /* MOCK_STM32L0XX_HAL_H_ */
@@ -0,0 +1,354 @@
+/**
+ * @file        rfm69_spi_test.c
+ * @brief       Host test of the RFM69 SPI transports against a simulated SPI peripheral
+ * @author      Esteban CADIC
+ * @version     1.0
+ * @date        2025
+ * @copyright   MIT License
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hal_mock.h"
+#include "rfm69.h"
+
+
+/*------------------------------------------------------------------------------
+	CONSTANTS
+------------------------------------------------------------------------------*/
+
+#define CHECK(condition)																\
+	do																					\
+	{																					\
+		if(!(condition))																\
+		{																				\
+			printf("%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #condition);	\
+			failures++;																	\
+		}																				\
+	} while(0)
+
+
+/*------------------------------------------------------------------------------
+	DECLARATIONS
+------------------------------------------------------------------------------*/
+
+static int failures;
+
+static SPI_HandleTypeDef spi;
+static GPIO_TypeDef gpio;
+static RFM69_t rfm69;
+
+// Consecutive registers: RegBitrateMsb to RegFrfMsb
+static const uint8_t config_3[][2] = { { 0x03, 0x1A }, { 0x04, 0x0B }, { 0x05, 0x00 } };
+static const uint8_t config_4[][2] = { { 0x03, 0x1A }, { 0x04, 0x0B }, { 0x05, 0x00 }, { 0x06, 0x52 } };
+
+
+/*------------------------------------------------------------------------------
+	FONCTIONS
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief Reset the simulated bus and the RFM69 structure (empty shadow, every register is sent).
+ *
+ * @param transport SPI transport under test.
+ */
+static void Setup(uint8_t transport)
+{
+	MOCK_Reset();
+	memset(&rfm69, 0, sizeof(rfm69));
+
+	rfm69.spi = &spi;
+	rfm69.spi_transport = transport;
+	rfm69.cs.port = &gpio;
+	rfm69.cs.pin = GPIO_PIN_4;
+}
+
+/**
+ * @brief Transfers shorter than RFM69_DMA_MIN_SIZE stay blocking with the DMA transport.
+ */
+static void TestBlockingBelowMinSize(void)
+{
+	Setup(RFM69_SPI_DMA);
+
+	RFM69_SetCustomConfig(&rfm69, config_3, 3);
+
+	CHECK(mock_spi.dma_transfers == 0);
+	CHECK(mock_spi.blocking_transfers == 2); // Address, then 3 data bytes
+	CHECK(mock_spi.wfi_calls == 0);
+	CHECK(mock_spi.regs[0x03] == 0x1A && mock_spi.regs[0x04] == 0x0B && mock_spi.regs[0x05] == 0x00);
+}
+
+/**
+ * @brief A burst write of RFM69_DMA_MIN_SIZE bytes goes through DMA, the core waits in WFI with
+ * interrupts masked around the state check, and the chip select is held until the end of the transfer.
+ */
+static void TestDmaWrite(void)
+{
+	Setup(RFM69_SPI_DMA);
+
+	RFM69_SetCustomConfig(&rfm69, config_4, 4);
+
+	CHECK(mock_spi.dma_transfers == 1);
+	CHECK(mock_spi.blocking_transfers == 1); // Address byte
+	CHECK(mock_spi.wfi_calls >= 1);
+	CHECK(mock_spi.wfi_unmasked == 0);
+	CHECK(mock_spi.state_unmasked == 0);
+	CHECK(mock_spi.busy_access == 0);
+	CHECK(mock_spi.irq_masked == 0);
+	CHECK(mock_spi.regs[0x03] == 0x1A && mock_spi.regs[0x06] == 0x52);
+	CHECK(rfm69.spi_transactions == 1);
+}
+
+/**
+ * @brief A burst read (shadow resynchronization) goes through DMA and returns the register values.
+ */
+static void TestDmaRead(void)
+{
+	Setup(RFM69_SPI_DMA);
+
+	for(uint8_t reg = RFM69_SHADOW_FIRST; reg <= RFM69_SHADOW_LAST; reg++)
+		mock_spi.regs[reg] = reg ^ 0x5A;
+
+	CHECK(RFM69_ResyncShadow(&rfm69) == 0);
+
+	CHECK(mock_spi.dma_transfers == 1);
+	CHECK(mock_spi.wfi_unmasked == 0);
+	CHECK(mock_spi.state_unmasked == 0);
+	CHECK(mock_spi.busy_access == 0);
+	CHECK(mock_spi.irq_masked == 0);
+	CHECK(rfm69._shadow[0x07 - RFM69_SHADOW_FIRST] == (0x07 ^ 0x5A));
+	CHECK(rfm69._shadow[0x3C - RFM69_SHADOW_FIRST] == (0x3C ^ 0x5A));
+}
+
+/**
+ * @brief Read-only register bits (RegLna gain set by the AGC) are neither counted as
+ * mismatches nor make the driver rewrite an unchanged configuration.
+ */
+static void TestShadowReadOnlyBits(void)
+{
+	static const uint8_t lna_config[][2] = { { 0x18, 0x88 } };
+	uint32_t spi_transactions;
+
+	Setup(RFM69_SPI_DMA);
+
+	RFM69_SetCustomConfig(&rfm69, lna_config, 1);
+	mock_spi.regs[0x18] |= 0x18; // LnaCurrentGain changed by the AGC
+
+	CHECK(RFM69_ResyncShadow(&rfm69) == 0);
+
+	spi_transactions = rfm69.spi_transactions;
+	RFM69_SetCustomConfig(&rfm69, lna_config, 1);
+	CHECK(rfm69.spi_transactions == spi_transactions);
+
+	// A corrupted configuration bit is still reported
+	mock_spi.regs[0x18] &= ~0x80;
+	CHECK(RFM69_ResyncShadow(&rfm69) == 1);
+}
+
+/**
+ * @brief If the DMA transfer cannot be started, the same bytes are sent in blocking mode.
+ */
+static void TestDmaErrorFallback(void)
+{
+	Setup(RFM69_SPI_DMA);
+	mock_spi.dma_errors_to_inject = 1;
+
+	RFM69_SetCustomConfig(&rfm69, config_4, 4);
+
+	CHECK(mock_spi.dma_transfers == 0);
+	CHECK(mock_spi.blocking_transfers == 2);
+	CHECK(mock_spi.wfi_calls == 0);
+	CHECK(mock_spi.irq_masked == 0);
+	CHECK(mock_spi.regs[0x03] == 0x1A && mock_spi.regs[0x06] == 0x52);
+}
+
+/**
+ * @brief The blocking transport never uses DMA.
+ */
+static void TestBlockingTransport(void)
+{
+	Setup(RFM69_SPI_BLOCKING);
+
+	RFM69_SetCustomConfig(&rfm69, config_4, 4);
+
+	CHECK(mock_spi.dma_transfers == 0);
+	CHECK(mock_spi.wfi_calls == 0);
+	CHECK(mock_spi.regs[0x06] == 0x52);
+}
+
+/**
+ * @brief Invalid arguments are reported with RFM69_ERROR and nothing is sent to the module.
+ */
+static void TestInvalidArguments(void)
+{
+	static const uint8_t fifo_config[][2] = { { 0x03, 0x1A }, { 0x00, 0x55 } };
+
+	Setup(RFM69_SPI_BLOCKING);
+
+	CHECK(RFM69_SetCustomConfig(&rfm69, fifo_config, 2) == RFM69_ERROR);
+	CHECK(RFM69_SetMode(&rfm69, RFM69_MODE_RX + 1) == RFM69_ERROR);
+	CHECK(RFM69_ChangeDI0Mapping(&rfm69, 4) == RFM69_ERROR);
+	CHECK(RFM69_ActiveListenMode(&rfm69, 0, 1, 1, 1) == RFM69_ERROR);
+	CHECK(RFM69_DisableListenMode(&rfm69, RFM69_MODE_RX + 1) == RFM69_ERROR);
+	CHECK(RFM69_SetAFC(&rfm69, 2) == RFM69_ERROR);
+	CHECK(RFM69_SetCrcFailureCount(&rfm69, 2) == RFM69_ERROR);
+	CHECK(rfm69.spi_transactions == 0);
+
+	CHECK(RFM69_SetCustomConfig(&rfm69, config_3, 3) == RFM69_OK);
+}
+
+/**
+ * @brief A send that never gets PacketSent ends in RFM69_TIMEOUT with the module back in sleep mode
+ * (PA off), and blocking calls are refused while an asynchronous operation is in progress.
+ */
+static void TestSendTimeout(void)
+{
+	static uint8_t message[4] = { 0x11, 0x22, 0x33, 0x44 };
+	int status;
+
+	Setup(RFM69_SPI_BLOCKING);
+	mock_spi.regs[0x27] = 0x80; // ModeReady, PacketSent (RegIrqFlags2) never set
+
+	CHECK(RFM69_StartSend(&rfm69, message, sizeof(message)) == RFM69_OK);
+	CHECK(RFM69_Poll(&rfm69) == RFM69_BUSY);
+	CHECK(((mock_spi.regs[0x01] >> 2) & 0x07) == RFM69_MODE_TX);
+
+	CHECK(RFM69_SetMode(&rfm69, RFM69_MODE_STANDBY) == RFM69_BUSY);
+	CHECK(RFM69_SendBurst(&rfm69, message, sizeof(message), 10) == 0 && RFM69_GetStatus(&rfm69) == RFM69_BUSY);
+	CHECK(RFM69_SampleNoise(&rfm69) == 0 && RFM69_GetStatus(&rfm69) == RFM69_BUSY);
+	CHECK(((mock_spi.regs[0x01] >> 2) & 0x07) == RFM69_MODE_TX);
+
+	while((status = RFM69_Poll(&rfm69)) == RFM69_BUSY)
+		;
+
+	CHECK(status == RFM69_TIMEOUT);
+	CHECK(((mock_spi.regs[0x01] >> 2) & 0x07) == RFM69_MODE_SLEEP);
+	CHECK(rfm69.counters[RFM69_COUNTER_SEND].timeouts == 1);
+}
+
+/**
+ * @brief A reception started with a 0 ms timeout still checks the FIFO once RX is ready.
+ */
+static void TestReceiveNoTimeout(void)
+{
+	uint8_t buffer[8];
+	int status;
+
+	Setup(RFM69_SPI_BLOCKING);
+	mock_spi.regs[0x27] = 0x80; // ModeReady
+	mock_spi.regs[0x28] = 0x04; // PayloadReady
+	mock_spi.regs[0x00] = 0; // Empty packet (variable length)
+
+	CHECK(RFM69_StartReceive(&rfm69, buffer, sizeof(buffer), 0) == RFM69_OK);
+
+	while((status = RFM69_Poll(&rfm69)) == RFM69_BUSY)
+		;
+
+	CHECK(status != RFM69_NO_PACKET);
+}
+
+/**
+ * @brief After a module reset, the configuration check restores the shadowed and high power
+ * registers but leaves the AES encryption off: the key registers were cleared with the reset.
+ */
+static void TestVerifyConfigAfterReset(void)
+{
+	static const uint8_t key[RFM69_AES_KEY_SIZE] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+			0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10 };
+
+	Setup(RFM69_SPI_DMA);
+	rfm69.high_power_en = 1;
+
+	RFM69_SetCustomConfig(&rfm69, config_4, 4);
+	RFM69_SetAESKey(&rfm69, key);
+	CHECK(RFM69_SetPowerDBm(&rfm69, 20) == 0);
+	CHECK(RFM69_VerifyConfig(&rfm69) == 1); // RegTestLna never written in this test
+
+	// Module reset: registers back to zero, test registers back to their defaults
+	memset(mock_spi.regs, 0, sizeof(mock_spi.regs));
+	mock_spi.regs[0x58] = 0x1B;
+	mock_spi.regs[0x5A] = 0x55;
+	mock_spi.regs[0x5C] = 0x70;
+	mock_spi.regs[0x01] = 0x04; // Standby
+
+	CHECK(RFM69_VerifyConfig(&rfm69) == 3 + 1 + 2 + 1); // Bitrate to Frf (RegFdevMsb already 0), RegPaLevel, RegTestPa1/2, AesOn
+	CHECK(mock_spi.regs[0x03] == 0x1A && mock_spi.regs[0x06] == 0x52);
+	CHECK(mock_spi.regs[0x11] == (0x60 | 31));
+	CHECK(mock_spi.regs[0x5A] == 0x5D && mock_spi.regs[0x5C] == 0x7C);
+	CHECK((mock_spi.regs[0x3D] & 0x01) == 0);
+	CHECK(!RFM69_AESIsEnabled(&rfm69));
+
+	CHECK(RFM69_VerifyConfig(&rfm69) == 0);
+
+	// The RegOpMode shadow follows the module: sleep mode is requested again
+	CHECK(RFM69_SetMode(&rfm69, RFM69_MODE_SLEEP) == RFM69_OK);
+	CHECK(((mock_spi.regs[0x01] >> 2) & 0x07) == RFM69_MODE_SLEEP);
+
+	// The key loaded again
+	CHECK(RFM69_SetAESKey(&rfm69, key) == RFM69_OK);
+	CHECK(RFM69_AESIsEnabled(&rfm69));
+	CHECK((mock_spi.regs[0x3D] & 0x01) && mock_spi.regs[0x3E] == 0x01 && mock_spi.regs[0x4D] == 0x10);
+
+	// Only AesOn corrupted: every other register matches, the loss is still reported
+	mock_spi.regs[0x3D] &= ~0x01;
+	CHECK(RFM69_VerifyConfig(&rfm69) == 1);
+	CHECK(!RFM69_AESIsEnabled(&rfm69));
+	CHECK((mock_spi.regs[0x3D] & 0x01) == 0);
+}
+
+/**
+ * @brief Operations run while the HAL tick is suspended or before the clocks are restored are
+ * counted but left out of the durations and of the SPI time.
+ */
+static void TestUntimedOperations(void)
+{
+	RFM69_Counter_t *noise = &rfm69.counters[RFM69_COUNTER_NOISE];
+
+	Setup(RFM69_SPI_DMA);
+	mock_spi.regs[0x23] = 0x00; // RssiDone never set: each sample ends on the HAL tick timeout
+	mock_spi.regs[0x27] = 0x80; // ModeReady
+
+	// HAL_SuspendTick()
+	mock_systick.CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+	RFM69_SampleNoise(&rfm69);
+
+	// Woken up from STOP: tick resumed but the SysTick reload doesn't match the core clock
+	mock_systick.CTRL |= SysTick_CTRL_TICKINT_Msk;
+	SystemCoreClock = 2097000;
+	RFM69_SampleNoise(&rfm69);
+
+	CHECK(noise->calls == 2);
+	CHECK(noise->untimed == 2);
+	CHECK(noise->total_us == 0 && noise->max_us == 0);
+	CHECK(rfm69.spi_time_us == 0);
+
+	// Clocks restored
+	SystemCoreClock = 32000000;
+	RFM69_SampleNoise(&rfm69);
+
+	CHECK(noise->calls == 3);
+	CHECK(noise->untimed == 2);
+	CHECK(noise->max_us > 0);
+	CHECK(noise->min_us == noise->max_us && noise->total_us == noise->max_us); // Only the timed call
+}
+
+int main(void)
+{
+	TestBlockingBelowMinSize();
+	TestDmaWrite();
+	TestDmaRead();
+	TestShadowReadOnlyBits();
+	TestDmaErrorFallback();
+	TestBlockingTransport();
+	TestInvalidArguments();
+	TestSendTimeout();
+	TestReceiveNoTimeout();
+	TestVerifyConfigAfterReset();
+	TestUntimedOperations();
+
+	printf("rfm69_spi_test: %s (%d failures)\n", failures ? "FAILED" : "OK", failures);
+
+	return failures != 0;
+}